@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+
+// Compares two sets of harness JSON results (single files or directories of them, e.g. two bench_all
+// runs) benchmark by benchmark. A difference is reported only when the Mann-Whitney U test rejects
+// "same distribution" at --alpha AND the median moved by more than --threshold percent; everything
+// else is treated as noise.
+
+namespace {
+    // Just enough JSON to read back what bench::Harness writes.
+    struct JsonValue {
+        enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+        double number = 0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> object;
+
+        const JsonValue & operator[](const std::string & key) const {
+            static const JsonValue null;
+            for (const auto & member : object) {
+                if (member.first == key)
+                    return member.second;
+            }
+            return null;
+        }
+
+        std::string to_string() const {
+            if (type == String)
+                return string;
+            std::ostringstream out;
+            if (type == Number)
+                out << number;
+            else if (type == Bool)
+                out << (number ? "true" : "false");
+            return out.str();
+        }
+    };
+
+    class JsonParser {
+    public:
+        explicit JsonParser(const std::string & text): text_(text), pos_(0) {}
+
+        JsonValue parse() {
+            JsonValue value = parse_value();
+            skip_whitespace();
+            if (pos_ != text_.size())
+                fail("trailing characters");
+            return value;
+        }
+
+    private:
+        void fail(const std::string & what) const {
+            throw std::runtime_error("JSON parse error at offset " + std::to_string(pos_) + ": " + what);
+        }
+
+        // Next character; a truncated file fails here instead of reading past the end.
+        char peek() const {
+            if (pos_ >= text_.size())
+                fail("unexpected end of input");
+            return text_[pos_];
+        }
+
+        void skip_whitespace() {
+            while (pos_ < text_.size() && std::isspace((unsigned char)text_[pos_]))
+                ++pos_;
+        }
+
+        void expect(char c) {
+            skip_whitespace();
+            if (pos_ >= text_.size() || text_[pos_] != c)
+                fail(std::string("expected '") + c + "'");
+            ++pos_;
+        }
+
+        bool consume(const std::string & literal) {
+            if (text_.compare(pos_, literal.size(), literal) != 0)
+                return false;
+            pos_ += literal.size();
+            return true;
+        }
+
+        JsonValue parse_value() {
+            skip_whitespace();
+            if (pos_ >= text_.size())
+                fail("unexpected end of input");
+
+            JsonValue value;
+            const char c = text_[pos_];
+            if (c == '{') {
+                value.type = JsonValue::Object;
+                ++pos_;
+                skip_whitespace();
+                if (peek() == '}') {
+                    ++pos_;
+                    return value;
+                }
+                do {
+                    skip_whitespace();
+                    std::string key = parse_string();
+                    expect(':');
+                    value.object.emplace_back(key, parse_value());
+                    skip_whitespace();
+                } while (peek() == ',' && ++pos_);
+                expect('}');
+            } else if (c == '[') {
+                value.type = JsonValue::Array;
+                ++pos_;
+                skip_whitespace();
+                if (peek() == ']') {
+                    ++pos_;
+                    return value;
+                }
+                do {
+                    value.array.push_back(parse_value());
+                    skip_whitespace();
+                } while (peek() == ',' && ++pos_);
+                expect(']');
+            } else if (c == '"') {
+                value.type = JsonValue::String;
+                value.string = parse_string();
+            } else if (consume("true")) {
+                value.type = JsonValue::Bool;
+                value.number = 1;
+            } else if (consume("false")) {
+                value.type = JsonValue::Bool;
+            } else if (consume("null")) {
+            } else {
+                value.type = JsonValue::Number;
+                const char * begin = text_.c_str() + pos_;
+                char * end = nullptr;
+                value.number = std::strtod(begin, &end);
+                if (end == begin)
+                    fail("unexpected character");
+                pos_ += end - begin;
+            }
+            return value;
+        }
+
+        std::string parse_string() {
+            if (peek() != '"')
+                fail("expected string");
+            ++pos_;
+            std::string s;
+            while (pos_ < text_.size() && text_[pos_] != '"') {
+                char c = text_[pos_++];
+                if (c == '\\' && pos_ < text_.size()) {
+                    c = text_[pos_++];
+                    switch (c) {
+                    case 'n': s += '\n'; break;
+                    case 't': s += '\t'; break;
+                    case 'u':
+                        if (pos_ + 4 > text_.size())
+                            fail("unexpected end of input");
+                        s += (char)std::stoi(text_.substr(pos_, 4), nullptr, 16);
+                        pos_ += 4;
+                        break;
+                    default: s += c;
+                    }
+                } else {
+                    s += c;
+                }
+            }
+            expect('"');
+            return s;
+        }
+
+        const std::string & text_;
+        size_t pos_;
+    };
+
+    struct HostInfo {
+        std::string path;
+        std::string label;
+        JsonValue host;
+    };
+
+    struct ResultSet {
+        // "benchmark: name" -> timed samples
+        std::map<std::string, std::vector<double>> samples;
+        // one per file
+        std::vector<HostInfo> hosts;
+    };
+
+    // Results are keyed by program name, or by file name when loading a directory, since bench_all runs
+    // some programs more than once with different arguments.
+    void load_file(const std::string & path, ResultSet & set, bool key_by_file) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        const std::string text = buffer.str();
+        const JsonValue root = JsonParser(text).parse();
+
+        const std::string benchmark = key_by_file ? std::filesystem::path(path).stem().string() : root["benchmark"].to_string();
+        set.hosts.push_back(HostInfo{ path, root["label"].to_string(), root["host"] });
+        // Two results under one key would be merged into a single sample set mixing two different
+        // measurements, which makes both the median and the test meaningless.
+        for (const auto & result : root["results"].array) {
+            const std::string key = benchmark + ": " + result["name"].to_string();
+            if (set.samples.count(key)) {
+                throw std::runtime_error("Duplicate result \"" + key + "\" in " + path);
+            }
+            std::vector<double> & samples = set.samples[key];
+            for (const auto & sample : result["samples_ns"].array)
+                samples.push_back(sample.number);
+        }
+    }
+
+    ResultSet load(const std::string & path) {
+        ResultSet set;
+        if (std::filesystem::is_directory(path)) {
+            std::vector<std::string> files;
+            for (const auto & entry : std::filesystem::directory_iterator(path)) {
+                if (entry.path().extension() == ".json")
+                    files.push_back(entry.path().string());
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto & file : files)
+                load_file(file, set, true);
+        } else {
+            load_file(path, set, false);
+        }
+        if (set.samples.empty()) {
+            throw std::runtime_error("No results found in " + path);
+        }
+        return set;
+    }
+
+    // Two-sided p-value of the Mann-Whitney U test. Uses the exact null distribution of U when the
+    // samples are small and tie-free (the usual case with a handful of repetitions, where the normal
+    // approximation is poor), otherwise the tie-corrected normal approximation.
+    double mann_whitney_p(const std::vector<double> & a, const std::vector<double> & b) {
+        const size_t n1 = a.size();
+        const size_t n2 = b.size();
+        const size_t n = n1 + n2;
+        if (n1 == 0 || n2 == 0)
+            return 1;
+
+        std::vector<std::pair<double, int>> pooled;
+        for (double x : a)
+            pooled.emplace_back(x, 0);
+        for (double x : b)
+            pooled.emplace_back(x, 1);
+        std::sort(pooled.begin(), pooled.end());
+
+        double rank_sum_a = 0;
+        double tie_term = 0;
+        bool has_ties = false;
+        for (size_t k = 0; k < n;) {
+            size_t end = k;
+            while (end < n && pooled[end].first == pooled[k].first)
+                ++end;
+            const double average_rank = (k + 1 + end) / 2.0;
+            const double t = end - k;
+            if (t > 1) {
+                has_ties = true;
+                tie_term += t * t * t - t;
+            }
+            for (size_t j = k; j < end; ++j) {
+                if (pooled[j].second == 0)
+                    rank_sum_a += average_rank;
+            }
+            k = end;
+        }
+
+        const double u = rank_sum_a - n1 * (n1 + 1) / 2.0;
+        const double mean_u = n1 * n2 / 2.0;
+
+        if (!has_ties && n <= 40) {
+            // ways[i][j][u]: arrangements of i a-values and j b-values with statistic u, via
+            // ways(u; i, j) = ways(u - j; i - 1, j) + ways(u; i, j - 1).
+            const size_t max_u = n1 * n2;
+            std::vector<std::vector<std::vector<double>>> ways(n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+            for (size_t i = 0; i <= n1; ++i) {
+                for (size_t j = 0; j <= n2; ++j) {
+                    ways[i][j].assign(i * j + 1, 0);
+                    if (i == 0 || j == 0) {
+                        ways[i][j][0] = 1;
+                        continue;
+                    }
+                    for (size_t v = 0; v <= i * j; ++v) {
+                        const double from_a = v >= j && v - j <= (i - 1) * j ? ways[i - 1][j][v - j] : 0;
+                        const double from_b = v <= i * (j - 1) ? ways[i][j - 1][v] : 0;
+                        ways[i][j][v] = from_a + from_b;
+                    }
+                }
+            }
+
+            const double distance = std::fabs(u - mean_u);
+            double extreme = 0;
+            double total = 0;
+            for (size_t v = 0; v <= max_u; ++v) {
+                total += ways[n1][n2][v];
+                if (std::fabs(v - mean_u) >= distance - 1e-9)
+                    extreme += ways[n1][n2][v];
+            }
+            return extreme / total;
+        }
+
+        const double variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1.0)));
+        if (variance <= 0)
+            return 1;
+        const double z = std::max(0.0, std::fabs(u - mean_u) - 0.5) / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.0));
+    }
+
+    double median(std::vector<double> samples) {
+        return bench::compute_stats(std::move(samples)).median_ns;
+    }
+
+    void print_hosts(const std::string & title, const ResultSet & set) {
+        std::cout << title << ":";
+        std::vector<std::string> seen;
+        for (const auto & host : set.hosts) {
+            std::ostringstream line;
+            if (!host.label.empty())
+                line << "[" << host.label << "] ";
+            line << host.host["processor"].to_string() << ", instruction set " << host.host["instruction_set"].to_string()
+                 << ", " << host.host["compiler"].to_string() << " " << host.host["build_type"].to_string()
+                 << " " << host.host["cxx_flags"].to_string() << ", " << host.host["hostname"].to_string();
+            if (std::find(seen.begin(), seen.end(), line.str()) == seen.end())
+                seen.push_back(line.str());
+        }
+        for (const auto & line : seen)
+            std::cout << (seen.size() > 1 ? "\n  " : " ") << line;
+        std::cout << std::endl;
+    }
+
+    std::string host_key(const JsonValue & host) {
+        return host["processor"].to_string() + "|" + host["instruction_set"].to_string() + "|" +
+               host["build_type"].to_string() + "|" + host["cxx_flags"].to_string();
+    }
+
+    int usage(const char * program) {
+        std::cerr << "Usage: " << program << " baseline.json|baseline_dir candidate.json|candidate_dir [--threshold=PERCENT] [--alpha=P]\n"
+                  << "  --threshold=PERCENT  smallest median change reported (default 2)\n"
+                  << "  --alpha=P            significance level of the Mann-Whitney U test (default 0.05)\n";
+        return -1;
+    }
+}
+
+int main(int argc, char * argv[]) {
+    double threshold_percent = 2;
+    double alpha = 0.05;
+    std::vector<std::string> paths;
+    for (int k = 1; k < argc; ++k) {
+        const std::string arg = argv[k];
+        if (arg.compare(0, 12, "--threshold=") == 0)
+            threshold_percent = std::stod(arg.substr(12));
+        else if (arg.compare(0, 8, "--alpha=") == 0)
+            alpha = std::stod(arg.substr(8));
+        else if (arg.compare(0, 2, "--") == 0)
+            return usage(argv[0]);
+        else
+            paths.push_back(arg);
+    }
+    if (paths.size() != 2) {
+        return usage(argv[0]);
+    }
+
+    ResultSet baseline;
+    ResultSet candidate;
+    try {
+        baseline = load(paths[0]);
+        candidate = load(paths[1]);
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    print_hosts("Baseline  " + paths[0], baseline);
+    print_hosts("Candidate " + paths[1], candidate);
+    // Every file is checked, since a directory may hold results from more than one machine or build.
+    const std::string reference = host_key(baseline.hosts.front().host);
+    for (const ResultSet * set : { &baseline, &candidate }) {
+        for (const auto & host : set->hosts) {
+            if (host_key(host.host) != reference)
+                std::cout << "Warning: processor or build configuration of " << host.path << " differs from "
+                          << baseline.hosts.front().path << std::endl;
+        }
+    }
+    std::cout << std::endl;
+
+    int faster = 0;
+    int slower = 0;
+    int unchanged = 0;
+    bool too_few_samples = false;
+    for (const auto & entry : baseline.samples) {
+        auto match = candidate.samples.find(entry.first);
+        if (match == candidate.samples.end()) {
+            std::cout << std::left << std::setw(56) << entry.first << std::right << " missing from candidate" << std::endl;
+            continue;
+        }
+
+        const double base = median(entry.second);
+        const double cand = median(match->second);
+        const double change = base > 0 ? (cand / base - 1) * 100 : 0;
+        const double p = mann_whitney_p(entry.second, match->second);
+        too_few_samples |= entry.second.size() < 4 || match->second.size() < 4;
+
+        std::string verdict = "~";
+        if (p < alpha && std::fabs(change) >= threshold_percent) {
+            verdict = change < 0 ? "faster" : "SLOWER";
+            ++(change < 0 ? faster : slower);
+        } else {
+            ++unchanged;
+        }
+
+        std::cout << std::left << std::setw(56) << entry.first << std::right
+                  << std::setw(12) << bench::format_duration(base) << " -> " << std::setw(12) << bench::format_duration(cand)
+                  << std::fixed << std::setprecision(1) << std::showpos << std::setw(9) << change << "%" << std::noshowpos
+                  << std::setprecision(3) << "  p=" << p << "  " << verdict << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+    for (const auto & entry : candidate.samples) {
+        if (baseline.samples.find(entry.first) == baseline.samples.end())
+            std::cout << std::left << std::setw(56) << entry.first << std::right << " new in candidate" << std::endl;
+    }
+
+    std::cout << std::endl << faster << " faster, " << slower << " slower, " << unchanged << " within noise"
+              << " (threshold " << threshold_percent << "%, alpha " << alpha << ")" << std::endl;
+    if (too_few_samples) {
+        std::cout << "Some benchmarks have fewer than 4 samples per side; with so few the test can never reach "
+                     "significance, rerun with more --reps" << std::endl;
+    }
+    // Nonzero on any regression, so the bench_compare target fails a CI run.
+    return slower > 0 ? 1 : 0;
+}
@@ -0,0 +1,498 @@
+#include "bench_harness.h"
+#include "perf_counter.h"
+#include "tsc_clock.h"
+#include "asmlib.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <unistd.h>
+
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "unknown"
+#endif
+#ifndef BENCH_CXX_FLAGS
+#define BENCH_CXX_FLAGS ""
+#endif
+
+namespace bench {
+
+namespace {
+    bool ends_with(const std::string & s, const std::string & suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string format_throughput(double items_per_run, const std::string & unit, double ns) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2);
+        const double per_second = items_per_run / (ns / 1e9);
+        if (unit == "bytes") {
+            out << per_second / 1048576.0 << " MB/s";
+        } else if (per_second >= 1e9) {
+            out << per_second / 1e9 << " G" << unit << "/s";
+        } else if (per_second >= 1e6) {
+            out << per_second / 1e6 << " M" << unit << "/s";
+        } else if (per_second >= 1e3) {
+            out << per_second / 1e3 << " K" << unit << "/s";
+        } else {
+            out << per_second << " " << unit << "/s";
+        }
+        return out.str();
+    }
+
+    std::string json_escape(const std::string & s) {
+        std::string escaped;
+        for (char c : s) {
+            switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    escaped += buf;
+                } else {
+                    escaped += c;
+                }
+            }
+        }
+        return escaped;
+    }
+
+    std::string csv_escape(const std::string & s) {
+        if (s.find_first_of(",\"\n") == std::string::npos)
+            return s;
+        std::string escaped = "\"";
+        for (char c : s) {
+            if (c == '"')
+                escaped += '"';
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+    // "0-3,8" -> CPUs 0, 1, 2, 3 and 8
+    void pin_to_cpus(const std::string & cpu_list) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        std::stringstream stream(cpu_list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            const size_t dash = range.find('-');
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            throw std::runtime_error("Failed to pin to CPUs " + cpu_list);
+        }
+#else
+        std::cerr << "CPU pinning is not supported on this platform, ignoring --pin=" << cpu_list << std::endl;
+#endif
+    }
+
+    const char * OPTIONS_HELP =
+        "Harness options:\n"
+        "  --warmup=N          untimed runs before measuring (default 1)\n"
+        "  --reps=N            timed runs (default 5)\n"
+        "  --time-budget=SEC   keep repeating until SEC seconds of timed runs, overrides --reps\n"
+        "  --pin=CPULIST       restrict the process to CPUs, e.g. 2 or 0-3,8\n"
+        "  --format=FMT        text, json or csv on stdout (default text)\n"
+        "  --out=FILE          also write results to FILE, JSON or CSV by extension\n"
+        "  --timer=CLOCK       steady (default) or tsc, cycle timer with overhead subtracted\n"
+        "  --label=TEXT        tag stored in the JSON output, e.g. the variant under test\n"
+        "  --perf              report hardware counters, IPC and bytes/cycle (Linux perf_event_open)\n";
+}
+
+std::string format_duration(double ns) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    if (ns < 1e3)
+        out << ns << " ns";
+    else if (ns < 1e6)
+        out << ns / 1e3 << " us";
+    else if (ns < 1e9)
+        out << ns / 1e6 << " ms";
+    else
+        out << ns / 1e9 << " s";
+    return out.str();
+}
+
+HostInfo host_info() {
+    HostInfo host;
+
+    char hostname[256] = {};
+    if (gethostname(hostname, sizeof(hostname) - 1) == 0)
+        host.hostname = hostname;
+
+    host.processor = ProcessorName();
+    CpuType(&host.cpu_vendor, &host.cpu_family, &host.cpu_model);
+    host.instruction_set = InstructionSet();
+
+#if defined(__clang__)
+    host.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    host.compiler = "gcc " __VERSION__;
+#endif
+    host.build_type = BENCH_BUILD_TYPE;
+    host.cxx_flags = BENCH_CXX_FLAGS;
+
+    char timestamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    host.timestamp = timestamp;
+
+    return host;
+}
+
+Stats compute_stats(std::vector<double> samples_ns) {
+    Stats stats;
+    if (samples_ns.empty())
+        return stats;
+
+    std::sort(samples_ns.begin(), samples_ns.end());
+    const size_t n = samples_ns.size();
+
+    stats.min_ns = samples_ns.front();
+    stats.max_ns = samples_ns.back();
+    stats.median_ns = n % 2 ? samples_ns[n / 2] : (samples_ns[n / 2 - 1] + samples_ns[n / 2]) / 2;
+    stats.p99_ns = samples_ns[(size_t)std::ceil(0.99 * n) - 1];
+
+    double sum = 0;
+    for (double s : samples_ns)
+        sum += s;
+    stats.mean_ns = sum / n;
+
+    double squares = 0;
+    for (double s : samples_ns)
+        squares += (s - stats.mean_ns) * (s - stats.mean_ns);
+    stats.stddev_ns = n > 1 ? std::sqrt(squares / (n - 1)) : 0;
+
+    return stats;
+}
+
+void State::start() {
+    elapsed_ns_ = 0;
+    running_ = false;
+    items_ = -1;
+    counters_.clear();
+    elapsed_ticks_ = 0;
+    if (perf_)
+        perf_->start();
+    running_ = true;
+    if (use_tsc_)
+        started_ticks_ = TscClock::start();
+    else
+        started_ = std::chrono::steady_clock::now();
+}
+
+void State::stop() {
+    pause_timing();
+}
+
+void State::pause_timing() {
+    if (running_) {
+        if (use_tsc_) {
+            const uint64_t ticks = TscClock::stop() - started_ticks_;
+            const uint64_t overhead = TscClock::overhead();
+            const uint64_t net = ticks > overhead ? ticks - overhead : 0;
+            elapsed_ticks_ += net;
+            elapsed_ns_ += net / TscClock::ticks_per_ns();
+        } else {
+            elapsed_ns_ += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started_).count();
+        }
+        running_ = false;
+        if (perf_)
+            perf_->stop();
+    }
+}
+
+void State::resume_timing() {
+    if (!running_) {
+        if (perf_)
+            perf_->resume();
+        running_ = true;
+        if (use_tsc_)
+            started_ticks_ = TscClock::start();
+        else
+            started_ = std::chrono::steady_clock::now();
+    }
+}
+
+void State::add_counter(const std::string & name, double value) {
+    for (auto & counter : counters_) {
+        if (counter.first == name) {
+            counter.second += value;
+            return;
+        }
+    }
+    counters_.emplace_back(name, value);
+}
+
+void State::set_items_processed(double items) {
+    items_ = items;
+}
+
+Harness::Harness(int argc, char * argv[], const std::string & usage): usage_(usage) {
+    program_ = argv[0];
+    const size_t slash = program_.find_last_of('/');
+    if (slash != std::string::npos)
+        program_ = program_.substr(slash + 1);
+
+    try {
+        parse_options(argc, argv);
+    } catch (std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        std::exit(usage_error());
+    }
+
+    if (use_tsc_ && !TscClock::supported()) {
+        std::cerr << "No invariant TSC on this machine, using --timer=steady" << std::endl;
+        use_tsc_ = false;
+    } else if (use_tsc_) {
+        // Calibrate now rather than inside the first timed run.
+        log() << "TSC " << TscClock::ticks_per_ns() << " GHz, timer overhead " << TscClock::overhead() << " cycles" << std::endl;
+    }
+
+    if (perf_ && !perf_->available()) {
+        std::cerr << "Hardware counters are unavailable (no PMU, or kernel.perf_event_paranoid too high), "
+                     "continuing without --perf" << std::endl;
+        perf_.reset();
+    } else if (perf_ && !perf_->unavailable().empty()) {
+        std::cerr << "Hardware counters not supported here:";
+        for (const auto & name : perf_->unavailable())
+            std::cerr << " " << name;
+        std::cerr << std::endl;
+    }
+}
+
+void Harness::parse_options(int argc, char * argv[]) {
+    for (int k = 1; k < argc; ++k) {
+        const std::string arg = argv[k];
+        if (arg.compare(0, 2, "--") != 0) {
+            args_.push_back(arg);
+            continue;
+        }
+
+        if (arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " " << usage_ << " [harness options]\n" << OPTIONS_HELP;
+            std::exit(0);
+        }
+
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "warmup") {
+            warmup_ = std::stoi(value);
+        } else if (key == "reps") {
+            repetitions_ = std::max(1, std::stoi(value));
+        } else if (key == "time-budget") {
+            time_budget_s_ = std::stod(value);
+        } else if (key == "pin") {
+            pin_to_cpus(value);
+        } else if (key == "format") {
+            if (value != "text" && value != "json" && value != "csv")
+                throw std::runtime_error("Unknown output format: " + value);
+            format_ = value;
+        } else if (key == "out") {
+            output_path_ = value;
+        } else if (key == "timer") {
+            if (value != "steady" && value != "tsc")
+                throw std::runtime_error("Unknown timer: " + value);
+            use_tsc_ = value == "tsc";
+        } else if (key == "label") {
+            label_ = value;
+        } else if (key == "perf") {
+            perf_.reset(new PerfCounterSet());
+        } else {
+            throw std::runtime_error("Unknown harness option: " + arg);
+        }
+    }
+}
+
+Harness::~Harness() {
+    try {
+        finish();
+    } catch (std::exception & e) {
+        std::cerr << "Failed to write benchmark results: " << e.what() << std::endl;
+    }
+}
+
+int Harness::usage_error() const {
+    std::cerr << "Usage: " << program_ << " " << usage_ << " [harness options]\n" << OPTIONS_HELP;
+    return -1;
+}
+
+std::ostream & Harness::log() const {
+    return format_ == "text" ? std::cout : std::cerr;
+}
+
+Result & Harness::run_impl(const std::string & name, double items_per_run, const std::string & unit, const std::function<void(State &)> & proc) {
+    State state;
+    state.perf_ = perf_.get();
+    state.use_tsc_ = use_tsc_;
+    for (int k = 0; k < warmup_; ++k) {
+        state.start();
+        proc(state);
+        state.stop();
+    }
+
+    results_.emplace_back();
+    Result & result = results_.back();
+    result.name = name;
+    result.unit = unit;
+    result.items_per_run = items_per_run;
+
+    double timed_ns = 0;
+    while (time_budget_s_ > 0 ? timed_ns < time_budget_s_ * 1e9 || result.samples_ns.empty()
+                              : (int)result.samples_ns.size() < repetitions_) {
+        state.start();
+        proc(state);
+        state.stop();
+
+        result.samples_ns.push_back(state.elapsed_ns_);
+        timed_ns += state.elapsed_ns_;
+        if (state.items_ >= 0)
+            result.items_per_run = state.items_;
+
+        // TSC ticks are reference cycles at the nominal frequency, not core clock cycles; --perf gives those.
+        if (use_tsc_ && result.items_per_run > 0)
+            state.add_counter("cycles/item", state.elapsed_ticks_ / result.items_per_run);
+
+        if (perf_) {
+            for (const auto & value : perf_->read()) {
+                state.add_counter(value.first, value.second);
+                if (value.first == "cycles" && unit == "bytes" && value.second > 0)
+                    state.add_counter("bytes/cycle", result.items_per_run / value.second);
+            }
+        }
+
+        for (const auto & counter : state.counters_) {
+            auto existing = std::find_if(result.counters.begin(), result.counters.end(),
+                                         [&counter](const std::pair<std::string, double> & c) { return c.first == counter.first; });
+            if (existing == result.counters.end())
+                result.counters.push_back(counter);
+            else
+                existing->second += counter.second;
+        }
+    }
+
+    for (auto & counter : result.counters) {
+        counter.second /= result.samples_ns.size();
+    }
+    result.stats = compute_stats(result.samples_ns);
+
+    if (format_ == "text")
+        print_text(result);
+    return result;
+}
+
+void Harness::print_text(const Result & result) const {
+    std::cout << std::left << std::setw(36) << result.name << std::right
+              << " median " << std::setw(12) << format_duration(result.stats.median_ns)
+              << "  min " << std::setw(12) << format_duration(result.stats.min_ns)
+              << "  p99 " << std::setw(12) << format_duration(result.stats.p99_ns)
+              << "  sd " << std::setw(12) << format_duration(result.stats.stddev_ns)
+              << "  n=" << result.samples_ns.size();
+    if (result.items_per_run > 0 && result.stats.median_ns > 0)
+        std::cout << "  " << format_throughput(result.items_per_run, result.unit, result.stats.median_ns);
+    for (const auto & counter : result.counters)
+        std::cout << "  " << counter.first << "=" << counter.second;
+    std::cout << std::endl;
+}
+
+void Harness::write_json(std::ostream & out) const {
+    out << std::setprecision(17);
+    const HostInfo host = host_info();
+    out << "{\n  \"benchmark\": \"" << json_escape(program_) << "\",\n  \"label\": \"" << json_escape(label_) << "\",\n";
+    out << "  \"host\": {\"hostname\": \"" << json_escape(host.hostname) << "\""
+        << ", \"processor\": \"" << json_escape(host.processor) << "\""
+        << ", \"cpu_vendor\": " << host.cpu_vendor
+        << ", \"cpu_family\": " << host.cpu_family
+        << ", \"cpu_model\": " << host.cpu_model
+        << ", \"instruction_set\": " << host.instruction_set
+        << ", \"compiler\": \"" << json_escape(host.compiler) << "\""
+        << ", \"build_type\": \"" << json_escape(host.build_type) << "\""
+        << ", \"cxx_flags\": \"" << json_escape(host.cxx_flags) << "\""
+        << ", \"timestamp\": \"" << json_escape(host.timestamp) << "\"},\n";
+    out << "  \"results\": [";
+    for (size_t r = 0; r < results_.size(); ++r) {
+        const Result & result = results_[r];
+        out << (r ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(result.name) << "\""
+            << ", \"unit\": \"" << json_escape(result.unit) << "\""
+            << ", \"items_per_run\": " << result.items_per_run
+            << ", \"min_ns\": " << result.stats.min_ns
+            << ", \"median_ns\": " << result.stats.median_ns
+            << ", \"mean_ns\": " << result.stats.mean_ns
+            << ", \"p99_ns\": " << result.stats.p99_ns
+            << ", \"max_ns\": " << result.stats.max_ns
+            << ", \"stddev_ns\": " << result.stats.stddev_ns
+            << ", \"counters\": {";
+        for (size_t c = 0; c < result.counters.size(); ++c) {
+            out << (c ? ", " : "") << "\"" << json_escape(result.counters[c].first) << "\": " << result.counters[c].second;
+        }
+        out << "}, \"samples_ns\": [";
+        for (size_t s = 0; s < result.samples_ns.size(); ++s) {
+            out << (s ? ", " : "") << result.samples_ns[s];
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void Harness::write_csv(std::ostream & out) const {
+    out << std::setprecision(17);
+    out << "benchmark,name,unit,items_per_run,samples,min_ns,median_ns,mean_ns,p99_ns,max_ns,stddev_ns,counters\n";
+    for (const Result & result : results_) {
+        std::string counters;
+        for (const auto & counter : result.counters) {
+            std::ostringstream entry;
+            entry << std::setprecision(17) << counter.first << "=" << counter.second;
+            counters += (counters.empty() ? "" : ";") + entry.str();
+        }
+        out << csv_escape(program_) << "," << csv_escape(result.name) << "," << csv_escape(result.unit) << ","
+            << result.items_per_run << "," << result.samples_ns.size() << ","
+            << result.stats.min_ns << "," << result.stats.median_ns << "," << result.stats.mean_ns << ","
+            << result.stats.p99_ns << "," << result.stats.max_ns << "," << result.stats.stddev_ns << ","
+            << csv_escape(counters) << "\n";
+    }
+}
+
+void Harness::finish() {
+    if (finished_)
+        return;
+    finished_ = true;
+
+    if (format_ == "json")
+        write_json(std::cout);
+    else if (format_ == "csv")
+        write_csv(std::cout);
+
+    if (!output_path_.empty()) {
+        std::ofstream out(output_path_);
+        if (!out) {
+            throw std::runtime_error("Failed to open " + output_path_);
+        }
+        if (ends_with(output_path_, ".csv"))
+            write_csv(out);
+        else
+            write_json(out);
+    }
+}
+
+} // namespace bench
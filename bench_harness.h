@@ -0,0 +1,174 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class PerfCounterSet;
+
+namespace bench {
+
+// Keep the compiler from discarding a value or the stores that produced it. These replace summing
+// every output byte into an accumulator just so the work can't be optimized away.
+template <typename T>
+inline void do_not_optimize(const T & value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobber_memory() {
+    asm volatile("" : : : "memory");
+}
+
+struct Stats {
+    double min_ns = 0;
+    double median_ns = 0;
+    double mean_ns = 0;
+    double p99_ns = 0;
+    double max_ns = 0;
+    double stddev_ns = 0;
+};
+
+Stats compute_stats(std::vector<double> samples_ns);
+
+// "12.345 us" style, picking the unit by magnitude.
+std::string format_duration(double ns);
+
+// Where and how a result was produced, stored with every JSON result file so that runs from
+// different machines or build configurations are not compared by accident.
+struct HostInfo {
+    std::string hostname;
+    std::string processor;     // asmlib ProcessorName()
+    int cpu_vendor = 0;        // asmlib CpuType(): 1 Intel, 2 AMD, 3 VIA
+    int cpu_family = 0;
+    int cpu_model = 0;
+    int instruction_set = 0;   // asmlib InstructionSet() level, e.g. 4 SSE2, 10 AVX, 12 AVX2
+    std::string compiler;
+    std::string build_type;
+    std::string cxx_flags;
+    std::string timestamp;     // UTC, ISO 8601
+};
+
+HostInfo host_info();
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double items_per_run = 0;
+    std::vector<double> samples_ns;
+    Stats stats;
+    // Benchmark-defined values, averaged over the timed runs.
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+// Handed to a benchmark body that wants more than "time the whole call": it can exclude setup from
+// the measurement, record its own counters, or report how much work the run actually did.
+class State {
+public:
+    void pause_timing();
+    void resume_timing();
+
+    void add_counter(const std::string & name, double value);
+    void set_items_processed(double items);
+
+private:
+    friend class Harness;
+
+    void start();
+    void stop();
+
+    // Hardware counters follow the timer: paused and resumed with it. Null unless --perf.
+    PerfCounterSet * perf_ = nullptr;
+    bool use_tsc_ = false;
+    std::chrono::steady_clock::time_point started_;
+    uint64_t started_ticks_ = 0;
+    uint64_t elapsed_ticks_ = 0;
+    double elapsed_ns_ = 0;
+    bool running_ = false;
+    double items_ = -1;
+    std::vector<std::pair<std::string, double>> counters_;
+};
+
+// Parses the common options out of argv, runs every benchmark body with warmup and repetitions, and
+// prints min/median/p99/stddev per benchmark. Results are written as text, JSON or CSV on stdout and
+// optionally to a file when the harness goes out of scope.
+//
+//   --warmup=N          untimed runs before measuring (default 1)
+//   --reps=N            timed runs (default 5)
+//   --time-budget=SEC   keep repeating until SEC seconds of timed runs, overrides --reps
+//   --pin=CPULIST       restrict the process to CPUs, e.g. 2 or 0-3,8
+//   --format=FMT        text, json or csv on stdout (default text)
+//   --out=FILE          also write results to FILE, JSON or CSV by extension
+//   --timer=CLOCK       steady (default) or tsc: serialized rdtsc/rdtscp with calibrated frequency and
+//                       timer overhead subtracted; also reports cycles/item
+//   --label=TEXT        free-form tag stored in the JSON output, e.g. the variant under test
+//   --perf              also count cycles, instructions, LLC/dTLB/branch misses and page faults in the
+//                       timed region (including threads it spawns) and report IPC and bytes/cycle
+class Harness {
+public:
+    Harness(int argc, char * argv[], const std::string & usage);
+    ~Harness();
+
+    Harness(const Harness &) = delete;
+    Harness & operator=(const Harness &) = delete;
+
+    // Positional arguments left after the harness options are removed.
+    const std::vector<std::string> & args() const { return args_; }
+
+    // Prints usage for this benchmark plus the harness options to stderr; returns -1 for main().
+    int usage_error() const;
+
+    // Informational output. Goes to stdout in text mode and to stderr otherwise so structured output
+    // on stdout stays parseable.
+    std::ostream & log() const;
+
+    // Times proc(), or proc(State &) if it takes one. items_per_run/unit describe the work done by one
+    // call (e.g. bytes) and turn the median into a throughput.
+    template <typename Proc>
+    Result & run(const std::string & name, Proc && proc, double items_per_run = 0, const std::string & unit = "ops") {
+        return run_impl(name, items_per_run, unit, [&proc](State & state) {
+            if constexpr (std::is_invocable<Proc &, State &>::value)
+                proc(state);
+            else
+                proc();
+        });
+    }
+
+    // Writes the collected results; called by the destructor if not called earlier.
+    void finish();
+
+private:
+    void parse_options(int argc, char * argv[]);
+    Result & run_impl(const std::string & name, double items_per_run, const std::string & unit, const std::function<void(State &)> & proc);
+
+    void print_text(const Result & result) const;
+    void write_json(std::ostream & out) const;
+    void write_csv(std::ostream & out) const;
+
+    std::string program_;
+    std::string usage_;
+    std::vector<std::string> args_;
+
+    int warmup_ = 1;
+    int repetitions_ = 5;
+    double time_budget_s_ = 0;
+    std::string format_ = "text";
+    std::string output_path_;
+    std::string label_;
+    bool use_tsc_ = false;
+    std::unique_ptr<PerfCounterSet> perf_;
+
+    std::deque<Result> results_;
+    bool finished_ = false;
+};
+
+} // namespace bench
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,106 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Decompressed BGZF blocks keyed by the compressed offset of the block, shared between inflate threads.
+//
+// The cache is split into shards, each with its own mutex and LRU list, so concurrent lookups of
+// different blocks rarely contend. The memory budget is divided evenly between the shards and each
+// shard evicts from its LRU tail once its share is exceeded. Blocks are handed out as shared_ptr, so an
+// evicted block stays valid for a reader still using it.
+class BlockCache {
+public:
+    typedef std::shared_ptr<const std::vector<char>> Block;
+
+    BlockCache(size_t budget_bytes, size_t num_shards = 16)
+        : shards_(num_shards), shard_budget_(budget_bytes / num_shards), hits_(0), misses_(0) {}
+
+    BlockCache(const BlockCache &) = delete;
+    BlockCache & operator=(const BlockCache &) = delete;
+
+    // Returns the block and marks it most recently used, or null on a miss.
+    Block get(uint64_t offset) {
+        Shard & shard = shard_for(offset);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(offset);
+        if (found == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return Block();
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        return found->second->second;
+    }
+
+    // Inserts a block, evicting least recently used blocks of the same shard to stay in budget. If two
+    // threads missed on the same block concurrently, the first insert wins.
+    void put(uint64_t offset, Block block) {
+        Shard & shard = shard_for(offset);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.count(offset))
+            return;
+
+        shard.bytes += entry_bytes(*block);
+        shard.lru.emplace_front(offset, std::move(block));
+        shard.index[offset] = shard.lru.begin();
+
+        while (shard.bytes > shard_budget_ && shard.lru.size() > 1) {
+            shard.bytes -= entry_bytes(*shard.lru.back().second);
+            shard.index.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+        }
+    }
+
+    void clear() {
+        for (auto & shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+            shard.bytes = 0;
+        }
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    typedef std::list<std::pair<uint64_t, Block>> LruList;
+
+    struct Shard {
+        std::mutex mutex;
+        LruList lru;
+        std::unordered_map<uint64_t, LruList::iterator> index;
+        size_t bytes = 0;
+    };
+
+    // Payload plus a rough allowance for the list node, map entry and control block.
+    static size_t entry_bytes(const std::vector<char> & block) {
+        return block.capacity() + 128;
+    }
+
+    Shard & shard_for(uint64_t offset) {
+        // Block offsets are spread fairly evenly, but mix the bits so sequential blocks land on
+        // different shards.
+        offset ^= offset >> 33;
+        offset *= 0xff51afd7ed558ccdull;
+        offset ^= offset >> 33;
+        return shards_[offset % shards_.size()];
+    }
+
+    std::vector<Shard> shards_;
+    const size_t shard_budget_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+#endif // BLOCK_CACHE_H
@@ -1,71 +1,366 @@
-#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-std::random_device rand_device;
-std::default_random_engine engine(rand_device());
-std::uniform_int_distribution<int> distribution(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
- 
-namespace {
-    volatile int a = distribution(engine);
-    volatile int b = distribution(engine);
-    volatile int c = distribution(engine);
-    volatile int d = distribution(engine);
-    volatile int e = distribution(engine);
-    volatile int f = distribution(engine);
-    volatile int g = distribution(engine);
-    volatile int h = distribution(engine);
+#include <emmintrin.h>
+
+#include "bench_harness.h"
+#include "perf_counter.h"
+
+// Four signed int keys compared lexicographically, key[0] most significant.
+struct alignas(16) Record {
+    int32_t key[4];
+};
+
+constexpr int three_way(int32_t x, int32_t y) {
+    return (x > y) - (x < y);
 }
 
-int compareMethod2() {
-    if (a != b)
-        return a - b;
-    else if (c != d)
-        return c - d;
-    else if (e != f)
-        return e - f;
-    else if (g != h)
-        return g - h;
-    else 
+int compareMethod2(const Record & x, const Record & y) {
+    if (x.key[0] != y.key[0])
+        return three_way(x.key[0], y.key[0]);
+    else if (x.key[1] != y.key[1])
+        return three_way(x.key[1], y.key[1]);
+    else if (x.key[2] != y.key[2])
+        return three_way(x.key[2], y.key[2]);
+    else if (x.key[3] != y.key[3])
+        return three_way(x.key[3], y.key[3]);
+    else
         return 0;
 }
 
-int compareMethod1() {
+int compareMethod1(const Record & x, const Record & y) {
     int retval = 0;
 
-    if (retval == 0) retval = a - b;
-    if (retval == 0) retval = c - d;
-    if (retval == 0) retval = e - f;
-    if (retval == 0) retval = g - h;
+    if (retval == 0) retval = three_way(x.key[0], y.key[0]);
+    if (retval == 0) retval = three_way(x.key[1], y.key[1]);
+    if (retval == 0) retval = three_way(x.key[2], y.key[2]);
+    if (retval == 0) retval = three_way(x.key[3], y.key[3]);
 
     return retval;
 }
 
+// Comparator generated at compile time for any list of key indices, most significant first:
+// FieldListCompare<0, 1, 2, 3> is the full lexicographic order, FieldListCompare<3, 0> sorts by
+// key[3] and breaks ties on key[0]. The fold expands to the same chain compareMethod1 spells out.
+template <int... Fields>
+struct FieldListCompare {
+    static constexpr int compare(const Record & x, const Record & y) {
+        int retval = 0;
+        ((retval = retval != 0 ? retval : three_way(x.key[Fields], y.key[Fields])), ...);
+        return retval;
+    }
+
+    constexpr bool operator()(const Record & x, const Record & y) const {
+        return compare(x, y) < 0;
+    }
+};
 
+static_assert(FieldListCompare<0, 1, 2, 3>::compare(Record{ { 1, 2, 3, 4 } }, Record{ { 1, 2, 3, 5 } }) < 0, "");
+static_assert(FieldListCompare<3, 0>::compare(Record{ { 2, 0, 0, 1 } }, Record{ { 1, 0, 0, 1 } }) > 0, "");
 
-int main(int argc, char * argv[]) {
-    if (argc != 2)
-        return -1;
+// Flipping the sign bit maps signed order onto unsigned order, so two keys concatenate into one
+// uint64_t and the whole record into a 128-bit (hi, lo) pair compared without branches.
+inline uint64_t pack_keys(int32_t major, int32_t minor) {
+    return ((uint64_t)((uint32_t)major ^ 0x80000000u) << 32) | ((uint32_t)minor ^ 0x80000000u);
+}
+
+inline bool lessPacked(const Record & x, const Record & y) {
+    const uint64_t x_hi = pack_keys(x.key[0], x.key[1]);
+    const uint64_t y_hi = pack_keys(y.key[0], y.key[1]);
+    const uint64_t x_lo = pack_keys(x.key[2], x.key[3]);
+    const uint64_t y_lo = pack_keys(y.key[2], y.key[3]);
+    return (x_hi < y_hi) | ((x_hi == y_hi) & (x_lo < y_lo));
+}
+
+// Compares all four lanes at once; the lowest lane that differs in either direction decides.
+inline bool lessSimd(const Record & x, const Record & y) {
+    const __m128i xv = _mm_load_si128(reinterpret_cast<const __m128i *>(x.key));
+    const __m128i yv = _mm_load_si128(reinterpret_cast<const __m128i *>(y.key));
+    const int lt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(xv, yv)));
+    const int gt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(xv, yv)));
+    const int differ = lt | gt;
+    return (lt & differ & -differ) != 0;
+}
+
+// LSD radix sort over the 16-byte concatenated key, one byte per pass from key[3]'s low byte up to
+// key[0]'s (sign-flipped) high byte. Passes where every record has the same byte are skipped.
+void radix_sort(std::vector<Record> & records) {
+    std::vector<Record> scratch(records.size());
+    Record * src = records.data();
+    Record * dst = scratch.data();
+    const size_t n = records.size();
+
+    for (int pass = 0; pass < 16; ++pass) {
+        const int field = 3 - pass / 4;
+        const int shift = (pass % 4) * 8;
+        const uint32_t flip = (pass % 4 == 3) ? 0x80u : 0u;
+
+        auto digit = [field, shift, flip](const Record & r) {
+            return (((uint32_t)r.key[field] >> shift) & 0xFFu) ^ flip;
+        };
+
+        size_t counts[256] = {};
+        for (size_t k = 0; k < n; ++k) {
+            ++counts[digit(src[k])];
+        }
 
-    const std::uint64_t loop_executions = std::stoull(argv[1]);
-    {
-        auto start = std::chrono::high_resolution_clock::now();
-        for (std::uint64_t k = 0; k < loop_executions; ++k)
-            compareMethod1();
-        auto end = std::chrono::high_resolution_clock::now();
+        if (n == 0 || counts[digit(src[0])] == n)
+            continue;
 
-        std::cout << std::chrono::duration<double, std::milli>(end - start).count() << std::endl;
+        size_t offset = 0;
+        for (auto & count : counts) {
+            size_t c = count;
+            count = offset;
+            offset += c;
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            dst[counts[digit(src[k])]++] = src[k];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != records.data()) {
+        std::memcpy(records.data(), src, n * sizeof(Record));
+    }
+}
+
+// Sorts num_threads contiguous chunks concurrently, then merges neighbouring runs pairwise, one
+// thread per merge, until a single run remains.
+template <typename Less>
+void parallel_sort(std::vector<Record> & records, int num_threads, Less less) {
+    const size_t n = records.size();
+    std::vector<size_t> bounds;
+    for (int t = 0; t <= num_threads; ++t) {
+        bounds.push_back(n * t / num_threads);
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&records, &bounds, less, t]() {
+            std::sort(records.begin() + bounds[t], records.begin() + bounds[t+1], less);
+        });
     }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    std::vector<Record> scratch(n);
+    std::vector<Record> * src = &records;
+    std::vector<Record> * dst = &scratch;
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged_bounds;
+        threads.clear();
+        for (size_t run = 0; run + 1 < bounds.size(); run += 2) {
+            merged_bounds.push_back(bounds[run]);
+            const size_t begin = bounds[run];
+            const size_t middle = bounds[run+1];
+            const size_t end = run + 2 < bounds.size() ? bounds[run+2] : middle;
+            threads.emplace_back([src, dst, begin, middle, end, less]() {
+                std::merge(src->begin() + begin, src->begin() + middle,
+                           src->begin() + middle, src->begin() + end,
+                           dst->begin() + begin, less);
+            });
+        }
+        merged_bounds.push_back(n);
+        for (auto & thread : threads) {
+            thread.join();
+        }
+        bounds.swap(merged_bounds);
+        std::swap(src, dst);
+    }
+
+    if (src != &records) {
+        records.swap(scratch);
+    }
+}
 
-    {
-        auto start = std::chrono::high_resolution_clock::now();
-        for (std::uint64_t k = 0; k < loop_executions; ++k)
-            compareMethod2();
-        auto end = std::chrono::high_resolution_clock::now();
+// Pairs whose first equal_prefix keys match and whose next key differs, so a short-circuiting
+// comparator takes exactly the branch path we ask for. A negative equal_prefix draws the prefix length
+// per pair: -1 uniformly from 0..4, -2 geometrically (each further key equal with probability 1/2).
+std::vector<std::pair<Record, Record>> generate_pairs(int equal_prefix, size_t num_pairs, std::mt19937 & gen) {
+    std::uniform_int_distribution<int32_t> full(std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+    std::uniform_int_distribution<int> uniform_prefix(0, 4);
+    std::bernoulli_distribution coin(0.5);
 
-        std::cout << std::chrono::duration<double, std::milli>(end - start).count() << std::endl;
+    std::vector<std::pair<Record, Record>> pairs(num_pairs);
+    for (auto & pair : pairs) {
+        int prefix = equal_prefix;
+        if (equal_prefix == -1) {
+            prefix = uniform_prefix(gen);
+        } else if (equal_prefix == -2) {
+            prefix = 0;
+            while (prefix < 4 && coin(gen))
+                ++prefix;
+        }
+
+        for (int k = 0; k < 4; ++k) {
+            pair.first.key[k] = full(gen);
+            pair.second.key[k] = k < prefix ? pair.first.key[k] : full(gen);
+        }
+        if (prefix < 4 && pair.second.key[prefix] == pair.first.key[prefix]) {
+            pair.second.key[prefix] ^= 1;
+        }
     }
+    return pairs;
+}
 
+template <typename Compare>
+void branch_run(bench::Harness & harness, const std::string & name, const std::vector<std::pair<Record, Record>> & pairs, Compare compare) {
+    PerfCounter branch_misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    PerfCounter instructions(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    const double n = pairs.size();
+
+    harness.run(name, [&](bench::State & state) {
+        int64_t accum = 0;
+        branch_misses.start();
+        instructions.start();
+        for (const auto & pair : pairs) {
+            accum += compare(pair.first, pair.second);
+        }
+        instructions.stop();
+        branch_misses.stop();
+        bench::do_not_optimize(accum);
+
+        if (branch_misses.valid() && instructions.valid()) {
+            state.add_counter("branch-misses/cmp", branch_misses.read() / n);
+            state.add_counter("instructions/cmp", instructions.read() / n);
+        }
+    }, n, "cmp");
+}
+
+void branch_study(bench::Harness & harness, size_t num_pairs, std::mt19937 & engine) {
+    const std::vector<std::pair<std::string, int>> streams = {
+        { "all fields differ", 0 },
+        { "first 1 field equal", 1 },
+        { "first 2 fields equal", 2 },
+        { "first 3 fields equal", 3 },
+        { "all fields equal", 4 },
+        { "random mix (uniform prefix)", -1 },
+        { "random mix (geometric prefix)", -2 },
+    };
+
+    harness.log() << num_pairs << " comparisons per stream" << std::endl;
+    for (const auto & stream : streams) {
+        const auto pairs = generate_pairs(stream.second, num_pairs, engine);
+        const std::string suffix = " [" + stream.first + "]";
+
+        // Every comparator is wrapped in a lambda so each gets its own branch_run instantiation and is
+        // inlined into the timed loop; a function pointer would put an indirect call in every comparison.
+        branch_run(harness, "compareMethod1" + suffix, pairs, [](const Record & x, const Record & y) { return compareMethod1(x, y); });
+        branch_run(harness, "compareMethod2" + suffix, pairs, [](const Record & x, const Record & y) { return compareMethod2(x, y); });
+        branch_run(harness, "FieldListCompare<0,1,2,3>" + suffix, pairs, [](const Record & x, const Record & y) {
+            return FieldListCompare<0, 1, 2, 3>::compare(x, y);
+        });
+        branch_run(harness, "packed key" + suffix, pairs, [](const Record & x, const Record & y) { return (int)lessPacked(x, y); });
+        branch_run(harness, "SSE2" + suffix, pairs, [](const Record & x, const Record & y) { return (int)lessSimd(x, y); });
+    }
+}
+
+std::vector<Record> generate_records(const std::string & distribution, size_t num_records, std::mt19937 & gen) {
+    std::uniform_int_distribution<int32_t> full(std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+    std::uniform_int_distribution<int32_t> tiny(0, 3);
+
+    std::vector<Record> records(num_records);
+    for (auto & r : records) {
+        if (distribution == "low_cardinality") {
+            r = Record{ { tiny(gen), tiny(gen), tiny(gen), tiny(gen) } };
+        } else if (distribution == "shared_prefix") {
+            r = Record{ { 42, tiny(gen), 7, full(gen) } };
+        } else {
+            r = Record{ { full(gen), full(gen), full(gen), full(gen) } };
+        }
+    }
+
+    if (distribution == "sorted") {
+        std::sort(records.begin(), records.end(), lessPacked);
+    } else if (distribution == "reverse_sorted") {
+        std::sort(records.begin(), records.end(), lessPacked);
+        std::reverse(records.begin(), records.end());
+    }
+    return records;
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "num_records [num_threads] | branch num_comparisons");
+    const std::vector<std::string> & args = harness.args();
+    if (args.size() < 1 || args.size() > 2) {
+        return harness.usage_error();
+    }
+
+    std::random_device rand_device;
+    std::mt19937 engine(rand_device());
+
+    if (args[0] == "branch") {
+        if (args.size() != 2) {
+            return harness.usage_error();
+        }
+        branch_study(harness, std::stoull(args[1]), engine);
+        return 0;
+    }
+
+    const size_t num_records = std::stoull(args[0]);
+    const int num_threads = args.size() > 1 ? std::stoi(args[1]) : std::max(1u, std::thread::hardware_concurrency());
+    if (num_threads < 1) {
+        return harness.usage_error();
+    }
+
+    typedef std::function<void(std::vector<Record> &)> SortProc;
+    const std::vector<std::pair<std::string, SortProc>> methods = {
+        { "std::sort compareMethod1", [](std::vector<Record> & v) {
+            std::sort(v.begin(), v.end(), [](const Record & x, const Record & y) { return compareMethod1(x, y) < 0; });
+        } },
+        { "std::sort compareMethod2", [](std::vector<Record> & v) {
+            std::sort(v.begin(), v.end(), [](const Record & x, const Record & y) { return compareMethod2(x, y) < 0; });
+        } },
+        { "std::sort FieldListCompare", [](std::vector<Record> & v) {
+            std::sort(v.begin(), v.end(), FieldListCompare<0, 1, 2, 3>());
+        } },
+        { "std::sort packed key", [](std::vector<Record> & v) {
+            std::sort(v.begin(), v.end(), lessPacked);
+        } },
+        { "std::sort SSE2", [](std::vector<Record> & v) {
+            std::sort(v.begin(), v.end(), lessSimd);
+        } },
+        { "LSD radix", [](std::vector<Record> & v) {
+            radix_sort(v);
+        } },
+        { "parallel packed key", [num_threads](std::vector<Record> & v) {
+            parallel_sort(v, num_threads, lessPacked);
+        } },
+    };
+
+    const std::vector<std::string> distributions = { "uniform", "low_cardinality", "shared_prefix", "sorted", "reverse_sorted" };
+
+    harness.log() << num_records << " records, " << num_threads << " threads for parallel sort" << std::endl;
+    for (const auto & distribution : distributions) {
+        const std::vector<Record> input = generate_records(distribution, num_records, engine);
+        std::vector<Record> records;
+
+        for (const auto & method : methods) {
+            harness.run(method.first + " [" + distribution + "]", [&](bench::State & state) {
+                state.pause_timing();
+                records = input;
+                state.resume_timing();
+
+                method.second(records);
+
+                state.pause_timing();
+                if (!std::is_sorted(records.begin(), records.end(), lessPacked)) {
+                    throw std::runtime_error(method.first + " produced unsorted output!");
+                }
+            }, num_records, "records");
+        }
+    }
 
     return 0;
-}
\ No newline at end of file
+}
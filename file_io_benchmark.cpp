@@ -1,17 +1,18 @@
 #include <algorithm>
-#include <chrono>
 #include <iostream>
 #include <random>
 #include <fstream>
 
+#include "bench_harness.h"
+
 int main(int argc, char * argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <num GB to write> <output_file>" << std::endl;
-        return -1;
+    bench::Harness harness(argc, argv, "<num GB to write> <output_file>");
+    if (harness.args().size() != 2) {
+        return harness.usage_error();
     }
 
-    uint64_t num_bytes = std::stoi(argv[1]) * 1024ull * 1024ull * 1024ull;
-    std::string output_file_path = argv[2];
+    uint64_t num_bytes = std::stod(harness.args()[0]) * 1024ull * 1024ull * 1024ull;
+    std::string output_file_path = harness.args()[1];
 
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -22,16 +23,18 @@ int main(int argc, char * argv[]) {
 
     std::generate(std::begin(input_vec), std::end(input_vec), [&dist, &gen](){return dist(gen);});
 
-    std::ofstream output_stream(output_file_path, std::ios_base::binary);
+    harness.log() << "Writing " << input_vec.size() << " bytes to " << output_file_path << std::endl;
 
-    auto start = std::chrono::steady_clock::now();
-    output_stream.write(input_vec.data(), input_vec.size());
-    output_stream.flush();
-    auto stop = std::chrono::steady_clock::now();
+    harness.run("ofstream write+flush", [&](bench::State & state) {
+        state.pause_timing();
+        std::ofstream output_stream(output_file_path, std::ios_base::binary | std::ios_base::trunc);
+        state.resume_timing();
 
-    std::cout << "Writing " << input_vec.size() << " bytes took: " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms" << std::endl;
-    std::cout << (num_bytes / 1024.0 * 1024 * 1024) / (std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() * 1000000.0) << " GiB/s" << std::endl;
+        output_stream.write(input_vec.data(), input_vec.size());
+        output_stream.flush();
 
+        state.pause_timing();
+    }, input_vec.size(), "bytes");
 
     return 0;
 }
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <emmintrin.h>
+
+#include "asmlib.h"
+#include "bench_harness.h"
+
+namespace {
+    // Bucket counts the table may pick at runtime, roughly 1.3 * 4^k and prime.
+    constexpr uint32_t BUCKET_PRIMES[] = { 1361, 5333, 21313, 85199, 340787, 1363151, 5452619, 21810389, 87241573 };
+    const size_t NUM_BUCKET_PRIMES = sizeof(BUCKET_PRIMES) / sizeof(BUCKET_PRIMES[0]);
+
+    const size_t DIVIDE_ARRAY_SIZE = 1 << 22;
+}
+
+// murmur3 finalizer
+inline uint32_t mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// Each reducer maps a 32-bit hash onto [0, d).
+
+struct HardwareMod {
+    explicit HardwareMod(uint32_t d): d_(d) {}
+    uint32_t operator()(uint32_t h) const { return h % d_; }
+    uint32_t d_;
+};
+
+template <uint32_t D>
+struct ConstantMod {
+    uint32_t operator()(uint32_t h) const { return h % D; }
+};
+
+struct AsmlibMod {
+    explicit AsmlibMod(uint32_t d): d_(d) { setdivisoru32(buffer_, d); }
+    uint32_t operator()(uint32_t h) const { return h - dividefixedu32(buffer_, h) * d_; }
+    uint32_t buffer_[2];
+    uint32_t d_;
+};
+
+struct AsmlibClassMod {
+    explicit AsmlibClassMod(uint32_t d): divisor_(d), d_(d) {}
+    uint32_t operator()(uint32_t h) const { return h - (h / divisor_) * d_; }
+    div_u32 divisor_;
+    uint32_t d_;
+};
+
+// Lemire, Kaser, Kurz: "Faster Remainder by Direct Computation". One 64-bit and one 128-bit multiply.
+struct FastMod {
+    explicit FastMod(uint32_t d): m_(UINT64_C(0xFFFFFFFFFFFFFFFF) / d + 1), d_(d) {}
+    uint32_t operator()(uint32_t h) const {
+        const uint64_t low_bits = m_ * h;
+        return (uint32_t)(((__uint128_t)low_bits * d_) >> 64);
+    }
+    uint64_t m_;
+    uint32_t d_;
+};
+
+// Lemire's fastrange: not a remainder, but a uniform map of [0, 2^32) onto [0, d) with one multiply.
+struct FastRange {
+    explicit FastRange(uint32_t d): d_(d) {}
+    uint32_t operator()(uint32_t h) const { return (uint32_t)(((uint64_t)h * d_) >> 32); }
+    uint32_t d_;
+};
+
+// SSE2 has no 32-bit low multiply; build it from two 32x32->64 multiplies on the even and odd lanes.
+inline __m128i mullo_epi32_sse2(__m128i a, __m128i b) {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+struct AsmlibVectorMod {
+    explicit AsmlibVectorMod(uint32_t d): d_(_mm_set1_epi32((int)d)) { setdivisorV4u32(buffer_, d); }
+    __m128i operator()(__m128i h) const { return _mm_sub_epi32(h, mullo_epi32_sse2(dividefixedV4u32(buffer_, h), d_)); }
+    __m128i buffer_[2];
+    __m128i d_;
+};
+
+// Calls proc with a ConstantMod<d>, so the compiler sees the bucket count as a literal and emits its
+// own multiply-shift sequence. Only the counts in BUCKET_PRIMES can be dispatched this way.
+template <typename Proc, size_t... I>
+void with_constant_mod(uint32_t d, Proc proc, std::index_sequence<I...>) {
+    const bool found = ((d == BUCKET_PRIMES[I] ? (proc(ConstantMod<BUCKET_PRIMES[I]>()), true) : false) || ...);
+    if (!found) {
+        throw std::runtime_error("Bucket count has no compile-time instantiation!");
+    }
+}
+
+template <typename Proc>
+void with_constant_mod(uint32_t d, Proc proc) {
+    with_constant_mod(d, proc, std::make_index_sequence<NUM_BUCKET_PRIMES>());
+}
+
+// The division and probe runs use the same reducers, so their result names carry a "div: " or "probe: "
+// prefix to keep them apart in the structured output.
+template <typename Reduce>
+void run_divide(bench::Harness & harness, const std::string & name, Reduce reduce, const std::vector<uint32_t> & input, uint32_t d, bool is_remainder = true) {
+    std::vector<uint32_t> output(input.size());
+    harness.run("div: " + name, [&]() {
+        for (size_t k = 0; k < input.size(); ++k) {
+            output[k] = reduce(input[k]);
+        }
+        bench::clobber_memory();
+    }, input.size(), "divisions");
+
+    for (size_t k = 0; k < input.size(); ++k) {
+        if (is_remainder ? output[k] != input[k] % d : output[k] >= d) {
+            throw std::runtime_error(name + " computed a wrong result!");
+        }
+    }
+}
+
+// The vector runs finish the last input.size() % lanes values with a scalar loop, so every value
+// counted in the throughput is actually divided and checked.
+void run_divide_vector(bench::Harness & harness, const std::vector<uint32_t> & input, uint32_t d) {
+    AsmlibVectorMod reduce(d);
+    AsmlibMod reduce_tail(d);
+    std::vector<uint32_t> output(input.size());
+    harness.run("div: asmlib V4u32", [&]() {
+        size_t k = 0;
+        for (; k + 4 <= input.size(); k += 4) {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&input[k]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&output[k]), reduce(h));
+        }
+        for (; k < input.size(); ++k) {
+            output[k] = reduce_tail(input[k]);
+        }
+        bench::clobber_memory();
+    }, input.size(), "divisions");
+
+    for (size_t k = 0; k < input.size(); ++k) {
+        if (output[k] != input[k] % d) {
+            throw std::runtime_error("asmlib V4u32 computed a wrong result!");
+        }
+    }
+}
+
+void run_divide_u16(bench::Harness & harness, const std::vector<uint32_t> & input, uint16_t d) {
+    std::vector<uint16_t> input16(input.size());
+    for (size_t k = 0; k < input.size(); ++k) {
+        input16[k] = (uint16_t)input[k];
+    }
+
+    volatile uint16_t runtime_d = d;
+    std::vector<uint16_t> scalar_output(input16.size());
+    harness.run("div: hardware div u16", [&]() {
+        const uint16_t divisor = runtime_d;
+        for (size_t k = 0; k < input16.size(); ++k) {
+            scalar_output[k] = input16[k] / divisor;
+        }
+        bench::clobber_memory();
+    }, input16.size(), "divisions");
+
+    __m128i buffer[2];
+    setdivisorV8u16(buffer, d);
+    std::vector<uint16_t> vector_output(input16.size());
+    harness.run("div: asmlib V8u16", [&]() {
+        size_t k = 0;
+        for (; k + 8 <= input16.size(); k += 8) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&input16[k]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&vector_output[k]), dividefixedV8u16(buffer, x));
+        }
+        for (; k < input16.size(); ++k) {
+            vector_output[k] = input16[k] / d;
+        }
+        bench::clobber_memory();
+    }, input16.size(), "divisions");
+    if (!std::equal(scalar_output.begin(), scalar_output.end(), vector_output.begin())) {
+        throw std::runtime_error("asmlib V8u16 computed a wrong result!");
+    }
+}
+
+// Open-addressing table of non-zero uint32_t keys with linear probing. The home bucket of a key is
+// reduce(mix32(key)), so the reducer is the only thing that differs between runs.
+template <typename Reduce>
+class ProbeTable {
+public:
+    ProbeTable(uint32_t num_buckets, Reduce reduce): slots_(num_buckets, 0), reduce_(reduce) {}
+
+    void insert(uint32_t key) {
+        uint32_t index = reduce_(mix32(key));
+        while (slots_[index] != 0 && slots_[index] != key) {
+            index = next(index);
+        }
+        slots_[index] = key;
+    }
+
+    bool contains(uint32_t key) const {
+        return contains_from(key, reduce_(mix32(key)));
+    }
+
+    bool contains_from(uint32_t key, uint32_t index) const {
+        while (true) {
+            const uint32_t slot = slots_[index];
+            if (slot == key)
+                return true;
+            if (slot == 0)
+                return false;
+            index = next(index);
+        }
+    }
+
+private:
+    uint32_t next(uint32_t index) const {
+        return index + 1 == slots_.size() ? 0 : index + 1;
+    }
+
+    std::vector<uint32_t> slots_;
+    Reduce reduce_;
+};
+
+template <typename Reduce>
+void run_probe(bench::Harness & harness, const std::string & name, Reduce reduce, uint32_t num_buckets, const std::vector<uint32_t> & keys,
+               const std::vector<uint32_t> & queries, uint64_t expected_hits) {
+    ProbeTable<Reduce> table(num_buckets, reduce);
+    for (uint32_t key : keys) {
+        table.insert(key);
+    }
+
+    harness.run("probe: " + name, [&]() {
+        uint64_t hits = 0;
+        for (uint32_t query : queries) {
+            hits += table.contains(query);
+        }
+        if (hits != expected_hits) {
+            throw std::runtime_error(name + " found the wrong number of keys!");
+        }
+    }, queries.size(), "lookups");
+}
+
+// Same table keyed by asmlib's scalar reducer, but home buckets for four queries are computed at once
+// with the V4u32 divider before probing them one by one.
+void run_probe_vector(bench::Harness & harness, uint32_t num_buckets, const std::vector<uint32_t> & keys, const std::vector<uint32_t> & queries, uint64_t expected_hits) {
+    ProbeTable<AsmlibMod> table(num_buckets, AsmlibMod(num_buckets));
+    for (uint32_t key : keys) {
+        table.insert(key);
+    }
+
+    AsmlibVectorMod reduce(num_buckets);
+    harness.run("probe: asmlib V4u32", [&]() {
+        uint64_t hits = 0;
+        alignas(16) uint32_t hashes[4];
+        alignas(16) uint32_t buckets[4];
+        size_t k = 0;
+        for (; k + 4 <= queries.size(); k += 4) {
+            for (int lane = 0; lane < 4; ++lane) {
+                hashes[lane] = mix32(queries[k+lane]);
+            }
+            _mm_store_si128(reinterpret_cast<__m128i *>(buckets), reduce(_mm_load_si128(reinterpret_cast<const __m128i *>(hashes))));
+            for (int lane = 0; lane < 4; ++lane) {
+                hits += table.contains_from(queries[k+lane], buckets[lane]);
+            }
+        }
+        for (; k < queries.size(); ++k) {
+            hits += table.contains(queries[k]);
+        }
+        if (hits != expected_hits) {
+            throw std::runtime_error("asmlib V4u32 found the wrong number of keys!");
+        }
+    }, queries.size(), "lookups");
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[num_keys] [max_load_percent]");
+    if (harness.args().size() > 2) {
+        return harness.usage_error();
+    }
+
+    const uint64_t num_keys = harness.args().size() > 0 ? std::stoull(harness.args()[0]) : 1000000;
+    const uint64_t max_load_percent = harness.args().size() > 1 ? std::stoull(harness.args()[1]) : 50;
+
+    // The bucket count is picked at runtime, as a real table would when it grows.
+    const uint64_t min_buckets = num_keys * 100 / max_load_percent + 1;
+    const uint32_t * bucket_prime = std::lower_bound(std::begin(BUCKET_PRIMES), std::end(BUCKET_PRIMES), min_buckets);
+    if (bucket_prime == std::end(BUCKET_PRIMES)) {
+        std::cerr << "Too many keys for the largest bucket count " << BUCKET_PRIMES[NUM_BUCKET_PRIMES - 1] << std::endl;
+        return -1;
+    }
+    const uint32_t num_buckets = *bucket_prime;
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> dist(1, std::numeric_limits<uint32_t>::max());
+
+    std::vector<uint32_t> input(DIVIDE_ARRAY_SIZE);
+    for (auto & x : input) {
+        x = dist(gen);
+    }
+
+    harness.log() << "Dividing " << input.size() << " values by " << num_buckets << std::endl;
+    run_divide(harness, "hardware div", HardwareMod(num_buckets), input, num_buckets);
+    with_constant_mod(num_buckets, [&](auto reduce) {
+        run_divide(harness, "compiler constant", reduce, input, num_buckets);
+    });
+    run_divide(harness, "asmlib dividefixedu32", AsmlibMod(num_buckets), input, num_buckets);
+    run_divide(harness, "asmlib div_u32", AsmlibClassMod(num_buckets), input, num_buckets);
+    run_divide_vector(harness, input, num_buckets);
+    run_divide(harness, "fastmod", FastMod(num_buckets), input, num_buckets);
+    run_divide(harness, "fastrange", FastRange(num_buckets), input, num_buckets, false);
+    run_divide_u16(harness, input, (uint16_t)BUCKET_PRIMES[0]);
+
+    // Half of the queries hit, half miss, in random order.
+    std::unordered_set<uint32_t> key_set;
+    while (key_set.size() < num_keys) {
+        key_set.insert(dist(gen));
+    }
+    std::vector<uint32_t> keys(key_set.begin(), key_set.end());
+
+    std::vector<uint32_t> queries;
+    queries.reserve(num_keys * 2);
+    queries.insert(queries.end(), keys.begin(), keys.end());
+    while (queries.size() < num_keys * 2) {
+        uint32_t miss = dist(gen);
+        if (key_set.count(miss) == 0)
+            queries.push_back(miss);
+    }
+    std::shuffle(queries.begin(), queries.end(), gen);
+
+    harness.log() << "Probing " << num_buckets << " buckets holding " << num_keys << " keys with " << queries.size() << " lookups" << std::endl;
+    run_probe(harness, "hardware div", HardwareMod(num_buckets), num_buckets, keys, queries, num_keys);
+    with_constant_mod(num_buckets, [&](auto reduce) {
+        run_probe(harness, "compiler constant", reduce, num_buckets, keys, queries, num_keys);
+    });
+    run_probe(harness, "asmlib dividefixedu32", AsmlibMod(num_buckets), num_buckets, keys, queries, num_keys);
+    run_probe(harness, "asmlib div_u32", AsmlibClassMod(num_buckets), num_buckets, keys, queries, num_keys);
+    run_probe_vector(harness, num_buckets, keys, queries, num_keys);
+    run_probe(harness, "fastmod", FastMod(num_buckets), num_buckets, keys, queries, num_keys);
+    run_probe(harness, "fastrange", FastRange(num_buckets), num_buckets, keys, queries, num_keys);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "zlib.h"
+
+#include "bench_harness.h"
+#include "kernel_registry.h"
+
+namespace {
+    const size_t KB = 1024;
+    const IsaLevel ALL_LEVELS[] = { IsaLevel::Generic, IsaLevel::SSE2, IsaLevel::AVX2, IsaLevel::AVX512 };
+}
+
+// Every level has to agree with the generic kernels, including on the odd sizes that exercise the tails.
+void verify(const KernelSet & kernels, const std::vector<uint8_t> & input) {
+    const KernelSet & reference = *kernels_for(IsaLevel::Generic);
+    std::vector<char> expected(input.size() * 2);
+    std::vector<char> actual(input.size() * 2);
+
+    std::vector<size_t> sizes;
+    for (size_t n = 0; n <= 300 && n <= input.size(); ++n)
+        sizes.push_back(n);
+    sizes.push_back(input.size() - 1);
+    sizes.push_back(input.size());
+
+    for (size_t n : sizes) {
+        kernels.copy(actual.data(), input.data(), n);
+        if (std::memcmp(actual.data(), input.data(), n) != 0)
+            throw std::runtime_error(std::string("copy [") + isa_name(kernels.level) + "] is wrong for " + std::to_string(n) + " bytes");
+
+        if (kernels.adler32(1, input.data(), n) != adler32(1, input.data(), n))
+            throw std::runtime_error(std::string("adler32 [") + isa_name(kernels.level) + "] is wrong for " + std::to_string(n) + " bytes");
+
+        reference.decode_nibbles(expected.data(), input.data(), n * 2 - (n & 1));
+        kernels.decode_nibbles(actual.data(), input.data(), n * 2 - (n & 1));
+        if (std::memcmp(actual.data(), expected.data(), n * 2 - (n & 1)) != 0)
+            throw std::runtime_error(std::string("decode_nibbles [") + isa_name(kernels.level) + "] is wrong for " + std::to_string(n) + " bytes");
+    }
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[buffer_KB]");
+    if (harness.args().size() > 1)
+        return harness.usage_error();
+
+    const size_t buffer_size = harness.args().size() > 0 ? std::stoull(harness.args()[0]) * KB : 256 * KB;
+    if (buffer_size == 0)
+        return harness.usage_error();
+
+    const char * forced = std::getenv("KERNEL_ISA");
+    harness.log() << "CPU supports " << isa_name(detect_isa()) << ", selected kernels: " << isa_name(kernels().level)
+                  << (forced ? std::string(" (KERNEL_ISA=") + forced + ")" : std::string()) << std::endl;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> byte(0, 255);
+    std::vector<uint8_t> input(buffer_size);
+    for (auto & b : input)
+        b = (uint8_t)byte(gen);
+    std::vector<char> output(buffer_size * 2);
+
+    std::vector<const KernelSet *> levels;
+    for (IsaLevel level : ALL_LEVELS) {
+        if (const KernelSet * set = kernels_for(level)) {
+            verify(*set, input);
+            levels.push_back(set);
+        }
+    }
+
+    harness.run("copy [std::memcpy]", [&]() {
+        std::memcpy(output.data(), input.data(), buffer_size);
+        bench::clobber_memory();
+    }, buffer_size, "bytes");
+    for (const KernelSet * set : levels) {
+        harness.run(std::string("copy [") + isa_name(set->level) + "]", [&]() {
+            set->copy(output.data(), input.data(), buffer_size);
+            bench::clobber_memory();
+        }, buffer_size, "bytes");
+    }
+
+    harness.run("adler32 [zlib]", [&]() {
+        bench::do_not_optimize(adler32(1, input.data(), buffer_size));
+    }, buffer_size, "bytes");
+    for (const KernelSet * set : levels) {
+        harness.run(std::string("adler32 [") + isa_name(set->level) + "]", [&]() {
+            bench::do_not_optimize(set->adler32(1, input.data(), buffer_size));
+        }, buffer_size, "bytes");
+    }
+
+    // Throughput is in packed input bytes; every byte expands to two bases.
+    for (const KernelSet * set : levels) {
+        harness.run(std::string("decode_nibbles [") + isa_name(set->level) + "]", [&]() {
+            set->decode_nibbles(output.data(), input.data(), buffer_size * 2);
+            bench::clobber_memory();
+        }, buffer_size, "bytes");
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "kernel_registry.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "asmlib.h"
+
+extern const KernelSet generic_kernels;
+extern const KernelSet sse2_kernels;
+extern const KernelSet avx2_kernels;
+extern const KernelSet avx512_kernels;
+
+namespace {
+    // XCR0: which register states the OS saves on context switch. CPUID only says the CPU has AVX;
+    // the OS has to enable the YMM (and for AVX-512 the opmask/ZMM) state too.
+    uint64_t xgetbv0() {
+        uint32_t eax, edx;
+        asm volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (uint64_t)edx << 32 | eax;
+    }
+
+    const KernelSet * all_kernels(IsaLevel level) {
+        switch (level) {
+        case IsaLevel::Generic: return &generic_kernels;
+        case IsaLevel::SSE2: return &sse2_kernels;
+        case IsaLevel::AVX2: return &avx2_kernels;
+        case IsaLevel::AVX512: return &avx512_kernels;
+        }
+        return &generic_kernels;
+    }
+
+    const KernelSet & select_kernels() {
+        const IsaLevel detected = detect_isa();
+        const char * forced = std::getenv("KERNEL_ISA");
+        if (forced == nullptr || *forced == '\0')
+            return *all_kernels(detected);
+
+        for (IsaLevel level : { IsaLevel::Generic, IsaLevel::SSE2, IsaLevel::AVX2, IsaLevel::AVX512 }) {
+            if (std::strcmp(forced, isa_name(level)) != 0)
+                continue;
+            if (level > detected) {
+                std::cerr << "KERNEL_ISA=" << forced << " is not supported by this machine, using "
+                          << isa_name(detected) << std::endl;
+                return *all_kernels(detected);
+            }
+            return *all_kernels(level);
+        }
+
+        std::cerr << "Unknown KERNEL_ISA=" << forced << " (expected generic, sse2, avx2 or avx512), using "
+                  << isa_name(detected) << std::endl;
+        return *all_kernels(detected);
+    }
+}
+
+const char * isa_name(IsaLevel level) {
+    switch (level) {
+    case IsaLevel::Generic: return "generic";
+    case IsaLevel::SSE2: return "sse2";
+    case IsaLevel::AVX2: return "avx2";
+    case IsaLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+IsaLevel detect_isa() {
+    int abcd[4];
+    cpuid_ex(abcd, 0, 0);
+    const int max_leaf = abcd[0];
+
+    cpuid_ex(abcd, 1, 0);
+    const bool sse2 = abcd[3] & (1 << 26);
+    const bool osxsave = abcd[2] & (1 << 27);
+    const bool avx = abcd[2] & (1 << 28);
+    if (!sse2)
+        return IsaLevel::Generic;
+    if (!osxsave || !avx || max_leaf < 7)
+        return IsaLevel::SSE2;
+
+    const uint64_t xcr0 = xgetbv0();
+    const bool ymm_state = (xcr0 & 0x6) == 0x6;
+    const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+    cpuid_ex(abcd, 7, 0);
+    const bool avx2 = abcd[1] & (1 << 5);
+    const bool avx512f = abcd[1] & (1 << 16);
+    const bool avx512bw = abcd[1] & (1 << 30);
+
+    if (avx512f && avx512bw && zmm_state)
+        return IsaLevel::AVX512;
+    if (avx2 && ymm_state)
+        return IsaLevel::AVX2;
+    return IsaLevel::SSE2;
+}
+
+const KernelSet * kernels_for(IsaLevel level) {
+    if (level > detect_isa())
+        return nullptr;
+    return all_kernels(level);
+}
+
+const KernelSet & kernels() {
+    static const KernelSet & selected = select_kernels();
+    return selected;
+}
@@ -0,0 +1,42 @@
+#ifndef KERNEL_REGISTRY_H
+#define KERNEL_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Hand-written kernels, compiled once per ISA level and dispatched at runtime the way asmlib does it
+// internally. Each level lives in its own translation unit built with the matching -m flags
+// (kernels_generic.cpp, kernels_sse2.cpp, kernels_avx2.cpp, kernels_avx512.cpp), so one binary runs on
+// every machine and uses the widest level the CPU and OS support.
+//
+// Setting KERNEL_ISA=generic|sse2|avx2|avx512 in the environment forces a level; a level above what the
+// machine supports is clamped to the best supported one.
+
+enum class IsaLevel { Generic, SSE2, AVX2, AVX512 };
+
+struct KernelSet {
+    IsaLevel level;
+
+    // Copies n bytes between non-overlapping buffers.
+    void (*copy)(void * dst, const void * src, size_t n);
+
+    // zlib-compatible Adler-32 of data, continuing from adler (1 for a fresh checksum).
+    uint32_t (*adler32)(uint32_t adler, const uint8_t * data, size_t n);
+
+    // Expands n BAM 4-bit encoded bases ("=ACMGRSVTWYHKDBN", high nibble first) from (n + 1) / 2 packed
+    // bytes into n ASCII characters.
+    void (*decode_nibbles)(char * out, const uint8_t * packed, size_t n);
+};
+
+const char * isa_name(IsaLevel level);
+
+// Best level this CPU and OS support, from CPUID and XGETBV.
+IsaLevel detect_isa();
+
+// Kernels compiled for the given level, or nullptr if this machine can't run them.
+const KernelSet * kernels_for(IsaLevel level);
+
+// The kernels selected at first use: the detected level, or KERNEL_ISA if set.
+const KernelSet & kernels();
+
+#endif // KERNEL_REGISTRY_H
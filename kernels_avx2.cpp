@@ -0,0 +1,91 @@
+#include <immintrin.h>
+
+#include "kernel_registry.h"
+#include "kernels_common.h"
+
+// AVX2 kernels, 32 bytes per vector. Built with -mavx2.
+
+namespace {
+    void copy_avx2(void * dst, const void * src, size_t n) {
+        char * d = static_cast<char *>(dst);
+        const char * s = static_cast<const char *>(src);
+        for (; n >= 128; n -= 128, d += 128, s += 128) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *)s);
+            const __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+            const __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+            const __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+            _mm256_storeu_si256((__m256i *)d, a);
+            _mm256_storeu_si256((__m256i *)(d + 32), b);
+            _mm256_storeu_si256((__m256i *)(d + 64), c);
+            _mm256_storeu_si256((__m256i *)(d + 96), e);
+        }
+        for (; n >= 32; n -= 32, d += 32, s += 32) {
+            _mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+        }
+        kernels_common::copy_scalar(d, s, n);
+    }
+
+    uint32_t hsum_epi32(__m256i v) {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return (uint32_t)_mm_cvtsi128_si32(sum);
+    }
+
+    uint32_t adler32_avx2(uint32_t adler, const uint8_t * data, size_t n) {
+        const size_t CHUNK = 32;
+        const size_t BLOCK = kernels_common::ADLER_NMAX / CHUNK * CHUNK;
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        // Weight of byte i within a chunk is CHUNK - i; maddubs multiplies unsigned data by signed weights.
+        const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                                 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+
+        while (n >= CHUNK) {
+            const size_t length = (n < BLOCK ? n : BLOCK) / CHUNK * CHUNK;
+            __m256i byte_sum = zero;
+            __m256i weighted_sum = zero;
+            __m256i prefix_sum = zero;
+            for (size_t k = 0; k < length; k += CHUNK) {
+                const __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + k));
+                prefix_sum = _mm256_add_epi32(prefix_sum, byte_sum);
+                byte_sum = _mm256_add_epi32(byte_sum, _mm256_sad_epu8(bytes, zero));
+                weighted_sum = _mm256_add_epi32(weighted_sum, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+            }
+            adler = kernels_common::adler32_combine_block(adler, length, CHUNK, hsum_epi32(byte_sum),
+                                                          hsum_epi32(weighted_sum), hsum_epi32(prefix_sum));
+            data += length;
+            n -= length;
+        }
+        return kernels_common::adler32_scalar(adler, data, n);
+    }
+
+    // 32 packed bytes -> 64 bases per iteration: split the nibbles, interleave them back into base order
+    // and translate with an in-register table lookup.
+    void decode_nibbles_avx2(char * out, const uint8_t * packed, size_t n) {
+        const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)kernels_common::BAM_BASES));
+        const __m256i low_mask = _mm256_set1_epi8(0xf);
+
+        size_t done = 0;
+        for (; done + 64 <= n; done += 64) {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i *)(packed + done / 2));
+            const __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_mask);
+            const __m256i low = _mm256_and_si256(bytes, low_mask);
+            // unpack works within 128-bit lanes, so put the lane halves back in order afterwards.
+            const __m256i first = _mm256_unpacklo_epi8(high, low);
+            const __m256i second = _mm256_unpackhi_epi8(high, low);
+            _mm256_storeu_si256((__m256i *)(out + done),
+                                _mm256_shuffle_epi8(table, _mm256_permute2x128_si256(first, second, 0x20)));
+            _mm256_storeu_si256((__m256i *)(out + done + 32),
+                                _mm256_shuffle_epi8(table, _mm256_permute2x128_si256(first, second, 0x31)));
+        }
+        kernels_common::decode_nibbles_scalar(out + done, packed + done / 2, n - done);
+    }
+}
+
+extern const KernelSet avx2_kernels = {
+    IsaLevel::AVX2,
+    copy_avx2,
+    adler32_avx2,
+    decode_nibbles_avx2,
+};
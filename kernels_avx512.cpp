@@ -0,0 +1,91 @@
+#include <immintrin.h>
+
+#include "kernel_registry.h"
+#include "kernels_common.h"
+
+// AVX-512 kernels, 64 bytes per vector. Built with -mavx512f -mavx512bw; the byte shuffles, SAD and
+// maddubs on 512-bit vectors all need BW.
+
+namespace {
+    void copy_avx512(void * dst, const void * src, size_t n) {
+        char * d = static_cast<char *>(dst);
+        const char * s = static_cast<const char *>(src);
+        for (; n >= 256; n -= 256, d += 256, s += 256) {
+            const __m512i a = _mm512_loadu_si512(s);
+            const __m512i b = _mm512_loadu_si512(s + 64);
+            const __m512i c = _mm512_loadu_si512(s + 128);
+            const __m512i e = _mm512_loadu_si512(s + 192);
+            _mm512_storeu_si512(d, a);
+            _mm512_storeu_si512(d + 64, b);
+            _mm512_storeu_si512(d + 128, c);
+            _mm512_storeu_si512(d + 192, e);
+        }
+        for (; n >= 64; n -= 64, d += 64, s += 64) {
+            _mm512_storeu_si512(d, _mm512_loadu_si512(s));
+        }
+        // The remainder is a single masked copy instead of a scalar loop.
+        if (n > 0) {
+            const __mmask64 mask = ~0ULL >> (64 - n);
+            _mm512_mask_storeu_epi8(d, mask, _mm512_maskz_loadu_epi8(mask, s));
+        }
+    }
+
+    uint32_t adler32_avx512(uint32_t adler, const uint8_t * data, size_t n) {
+        const size_t CHUNK = 64;
+        const size_t BLOCK = kernels_common::ADLER_NMAX / CHUNK * CHUNK;
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i ones = _mm512_set1_epi16(1);
+        // Weight of byte i within a chunk is CHUNK - i; maddubs multiplies unsigned data by signed weights.
+        const __m512i weights = _mm512_set_epi8(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                                                17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+                                                33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+                                                49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64);
+
+        while (n >= CHUNK) {
+            const size_t length = (n < BLOCK ? n : BLOCK) / CHUNK * CHUNK;
+            __m512i byte_sum = zero;
+            __m512i weighted_sum = zero;
+            __m512i prefix_sum = zero;
+            for (size_t k = 0; k < length; k += CHUNK) {
+                const __m512i bytes = _mm512_loadu_si512(data + k);
+                prefix_sum = _mm512_add_epi32(prefix_sum, byte_sum);
+                byte_sum = _mm512_add_epi32(byte_sum, _mm512_sad_epu8(bytes, zero));
+                weighted_sum = _mm512_add_epi32(weighted_sum, _mm512_madd_epi16(_mm512_maddubs_epi16(bytes, weights), ones));
+            }
+            adler = kernels_common::adler32_combine_block(adler, length, CHUNK, (uint32_t)_mm512_reduce_add_epi32(byte_sum),
+                                                          (uint32_t)_mm512_reduce_add_epi32(weighted_sum),
+                                                          (uint32_t)_mm512_reduce_add_epi32(prefix_sum));
+            data += length;
+            n -= length;
+        }
+        return kernels_common::adler32_scalar(adler, data, n);
+    }
+
+    // 64 packed bytes -> 128 bases per iteration, same scheme as the AVX2 version.
+    void decode_nibbles_avx512(char * out, const uint8_t * packed, size_t n) {
+        const __m512i table = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)kernels_common::BAM_BASES));
+        const __m512i low_mask = _mm512_set1_epi8(0xf);
+        // unpack works within 128-bit lanes; these gather the lane halves back into base order.
+        const __m512i first_order = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+        const __m512i second_order = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+
+        size_t done = 0;
+        for (; done + 128 <= n; done += 128) {
+            const __m512i bytes = _mm512_loadu_si512(packed + done / 2);
+            const __m512i high = _mm512_and_si512(_mm512_srli_epi16(bytes, 4), low_mask);
+            const __m512i low = _mm512_and_si512(bytes, low_mask);
+            const __m512i first = _mm512_unpacklo_epi8(high, low);
+            const __m512i second = _mm512_unpackhi_epi8(high, low);
+            _mm512_storeu_si512(out + done, _mm512_shuffle_epi8(table, _mm512_permutex2var_epi64(first, first_order, second)));
+            _mm512_storeu_si512(out + done + 64, _mm512_shuffle_epi8(table, _mm512_permutex2var_epi64(first, second_order, second)));
+        }
+        kernels_common::decode_nibbles_scalar(out + done, packed + done / 2, n - done);
+    }
+}
+
+extern const KernelSet avx512_kernels = {
+    IsaLevel::AVX512,
+    copy_avx512,
+    adler32_avx512,
+    decode_nibbles_avx512,
+};
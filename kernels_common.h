@@ -0,0 +1,77 @@
+#ifndef KERNELS_COMMON_H
+#define KERNELS_COMMON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Scalar building blocks shared by the per-ISA kernel files, used for tails and as the generic kernels.
+//
+// Everything here has internal linkage (static inline, not plain inline) on purpose. These files are
+// compiled with different -m flags, and an inline function with external linkage gets one definition
+// picked by the linker: it could be the AVX-512 copy, which would then run on machines without AVX-512.
+// For the same reason the kernel files avoid std:: templates. The inline only keeps -Wunused-function
+// quiet in files that don't use every helper.
+
+namespace kernels_common {
+
+static const uint32_t ADLER_MOD = 65521;
+// Largest n such that 255n(n+1)/2 + (n+1)(ADLER_MOD-1) fits in 32 bits, as in zlib.
+static const size_t ADLER_NMAX = 5552;
+
+static const char BAM_BASES[] = "=ACMGRSVTWYHKDBN";
+
+static inline void copy_scalar(void * dst, const void * src, size_t n) {
+    char * d = static_cast<char *>(dst);
+    const char * s = static_cast<const char *>(src);
+    for (; n >= 8; n -= 8, d += 8, s += 8) {
+        uint64_t word;
+        std::memcpy(&word, s, sizeof(word));
+        std::memcpy(d, &word, sizeof(word));
+    }
+    for (; n > 0; --n)
+        *d++ = *s++;
+}
+
+static inline uint32_t adler32_scalar(uint32_t adler, const uint8_t * data, size_t n) {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    while (n > 0) {
+        size_t block = n < ADLER_NMAX ? n : ADLER_NMAX;
+        n -= block;
+        for (; block > 0; --block) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= ADLER_MOD;
+        s2 %= ADLER_MOD;
+    }
+    return (s2 << 16) | s1;
+}
+
+static inline void decode_nibbles_scalar(char * out, const uint8_t * packed, size_t n) {
+    size_t k = 0;
+    for (; k + 1 < n; k += 2) {
+        const uint8_t byte = packed[k / 2];
+        out[k] = BAM_BASES[byte >> 4];
+        out[k + 1] = BAM_BASES[byte & 0xf];
+    }
+    if (k < n)
+        out[k] = BAM_BASES[packed[k / 2] >> 4];
+}
+
+// Folds the block sums of a vectorized Adler-32 into the running checksum. For a block of length
+// bytes split into chunks of chunk bytes: byte_sum is the sum of all bytes, weighted_sum is the sum of
+// (chunk - position in chunk) * byte, and prefix_sum is the sum over chunks of the byte sum of all
+// earlier chunks.
+static inline uint32_t adler32_combine_block(uint32_t adler, size_t length, size_t chunk, uint64_t byte_sum, uint64_t weighted_sum, uint64_t prefix_sum) {
+    uint64_t s1 = adler & 0xffff;
+    uint64_t s2 = adler >> 16;
+    s2 += length * s1 + chunk * prefix_sum + weighted_sum;
+    s1 += byte_sum;
+    return (uint32_t)((s2 % ADLER_MOD) << 16 | (s1 % ADLER_MOD));
+}
+
+} // namespace kernels_common
+
+#endif // KERNELS_COMMON_H
@@ -0,0 +1,12 @@
+#include "kernel_registry.h"
+#include "kernels_common.h"
+
+// Plain C++ reference kernels. Built with auto-vectorization off so this really is the scalar
+// baseline the other levels are measured against.
+
+extern const KernelSet generic_kernels = {
+    IsaLevel::Generic,
+    kernels_common::copy_scalar,
+    kernels_common::adler32_scalar,
+    kernels_common::decode_nibbles_scalar,
+};
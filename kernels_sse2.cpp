@@ -0,0 +1,69 @@
+#include <emmintrin.h>
+
+#include "kernel_registry.h"
+#include "kernels_common.h"
+
+// SSE2 kernels, 16 bytes per vector. SSE2 has no byte shuffle, so nibble decoding stays scalar at this
+// level.
+
+namespace {
+    void copy_sse2(void * dst, const void * src, size_t n) {
+        char * d = static_cast<char *>(dst);
+        const char * s = static_cast<const char *>(src);
+        for (; n >= 64; n -= 64, d += 64, s += 64) {
+            const __m128i a = _mm_loadu_si128((const __m128i *)s);
+            const __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+            const __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+            _mm_storeu_si128((__m128i *)d, a);
+            _mm_storeu_si128((__m128i *)(d + 16), b);
+            _mm_storeu_si128((__m128i *)(d + 32), c);
+            _mm_storeu_si128((__m128i *)(d + 48), e);
+        }
+        for (; n >= 16; n -= 16, d += 16, s += 16) {
+            _mm_storeu_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+        }
+        kernels_common::copy_scalar(d, s, n);
+    }
+
+    uint32_t hsum_epi32(__m128i v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return (uint32_t)_mm_cvtsi128_si32(v);
+    }
+
+    uint32_t adler32_sse2(uint32_t adler, const uint8_t * data, size_t n) {
+        const size_t CHUNK = 16;
+        const size_t BLOCK = kernels_common::ADLER_NMAX / CHUNK * CHUNK;
+        const __m128i zero = _mm_setzero_si128();
+        // Weight of byte i within a chunk is CHUNK - i.
+        const __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+        const __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+
+        while (n >= CHUNK) {
+            const size_t length = (n < BLOCK ? n : BLOCK) / CHUNK * CHUNK;
+            __m128i byte_sum = zero;
+            __m128i weighted_sum = zero;
+            __m128i prefix_sum = zero;
+            for (size_t k = 0; k < length; k += CHUNK) {
+                const __m128i bytes = _mm_loadu_si128((const __m128i *)(data + k));
+                prefix_sum = _mm_add_epi32(prefix_sum, byte_sum);
+                byte_sum = _mm_add_epi32(byte_sum, _mm_sad_epu8(bytes, zero));
+                weighted_sum = _mm_add_epi32(weighted_sum, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weights_lo));
+                weighted_sum = _mm_add_epi32(weighted_sum, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weights_hi));
+            }
+            adler = kernels_common::adler32_combine_block(adler, length, CHUNK, hsum_epi32(byte_sum),
+                                                          hsum_epi32(weighted_sum), hsum_epi32(prefix_sum));
+            data += length;
+            n -= length;
+        }
+        return kernels_common::adler32_scalar(adler, data, n);
+    }
+}
+
+extern const KernelSet sse2_kernels = {
+    IsaLevel::SSE2,
+    copy_sse2,
+    adler32_sse2,
+    kernels_common::decode_nibbles_scalar,
+};
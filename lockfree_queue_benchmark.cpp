@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_harness.h"
+
+namespace {
+    const size_t CACHE_LINE_SIZE = 64;
+    const size_t QUEUE_CAPACITY = 1024;
+    const uint64_t SENTINEL = std::numeric_limits<uint64_t>::max();
+}
+
+struct Item {
+    uint64_t value;
+    int64_t enqueue_time_ns;
+};
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Bounded multi-producer/multi-consumer ring after Dmitry Vyukov. Every cell carries a sequence number
+// that tells producers and consumers whether it is free for their current lap around the ring, so the
+// only shared writes are one CAS on the enqueue or dequeue cursor. The two cursors live on separate
+// cache lines so producers and consumers don't invalidate each other.
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity): buffer_(new Cell[capacity]), buffer_mask_(capacity - 1) {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::runtime_error("MpmcQueue capacity must be a power of two!");
+        }
+
+        for (size_t k = 0; k < capacity; ++k) {
+            buffer_[k].sequence.store(k, std::memory_order_relaxed);
+        }
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+    }
+
+    bool try_push(const T & data) {
+        Cell * cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &buffer_[pos & buffer_mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = data;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T & data) {
+        Cell * cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &buffer_[pos & buffer_mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        data = cell->data;
+        cell->sequence.store(pos + buffer_mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T & data) {
+        while (!try_push(data))
+            std::this_thread::yield();
+    }
+
+    void pop(T & data) {
+        while (!try_pop(data))
+            std::this_thread::yield();
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> buffer_;
+    const size_t buffer_mask_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_;
+};
+
+// Single-producer/single-consumer ring. Each side owns its cursor and keeps a cached copy of the
+// other side's cursor, so the shared cache line is only touched when the cached view says the ring
+// looks full (producer) or empty (consumer).
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity): buffer_(new T[capacity]), buffer_mask_(capacity - 1) {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::runtime_error("SpscQueue capacity must be a power of two!");
+        }
+
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    bool try_push(const T & data) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > buffer_mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > buffer_mask_)
+                return false;
+        }
+
+        buffer_[tail & buffer_mask_] = data;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T & data) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+                return false;
+        }
+
+        data = buffer_[head & buffer_mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T & data) {
+        while (!try_push(data))
+            std::this_thread::yield();
+    }
+
+    void pop(T & data) {
+        while (!try_pop(data))
+            std::this_thread::yield();
+    }
+
+private:
+    std::unique_ptr<T[]> buffer_;
+    const size_t buffer_mask_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;
+    size_t cached_head_ = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;
+    size_t cached_tail_ = 0;
+};
+
+// Baseline: bounded ring guarded by one mutex, with condition variables for full/empty waits.
+template <typename T>
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity): buffer_(capacity), head_(0), size_(0) {}
+
+    void push(const T & data) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this](){ return size_ < buffer_.size(); });
+        buffer_[(head_ + size_) % buffer_.size()] = data;
+        ++size_;
+        lock.unlock();
+        not_empty_.notify_one();
+    }
+
+    void pop(T & data) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this](){ return size_ > 0; });
+        data = buffer_[head_];
+        head_ = (head_ + 1) % buffer_.size();
+        --size_;
+        lock.unlock();
+        not_full_.notify_one();
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t head_;
+    size_t size_;
+
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+// Each producer pushes items_per_producer timestamped items; once all producers are done one sentinel
+// per consumer is pushed. Consumers record the enqueue-to-dequeue latency of every item they see.
+// Only the window between releasing the threads and joining them is timed.
+template <typename Queue>
+void run_queue(bench::State & state, int num_producers, int num_consumers, uint64_t items_per_producer) {
+    state.pause_timing();
+
+    Queue queue(QUEUE_CAPACITY);
+    std::atomic<bool> go(false);
+    std::atomic<int> producers_done(0);
+    std::vector<std::vector<int64_t>> latencies(num_consumers);
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_producers + num_consumers);
+
+    // Consumers don't get an even share of the items, so each one reserves room for all of them; a
+    // reallocation inside the timed window would show up as a latency spike.
+    for (int c = 0; c < num_consumers; ++c) {
+        latencies[c].reserve(items_per_producer * num_producers);
+        threads.emplace_back([&queue, &go, &latencies, c]() {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            std::vector<int64_t> & local = latencies[c];
+            Item item;
+            while (true) {
+                queue.pop(item);
+                if (item.value == SENTINEL)
+                    return;
+                local.push_back(now_ns() - item.enqueue_time_ns);
+            }
+        });
+    }
+
+    for (int p = 0; p < num_producers; ++p) {
+        threads.emplace_back([&queue, &go, &producers_done, num_producers, num_consumers, items_per_producer, p]() {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (uint64_t k = 0; k < items_per_producer; ++k) {
+                queue.push(Item{ p * items_per_producer + k, now_ns() });
+            }
+
+            if (producers_done.fetch_add(1) + 1 == num_producers) {
+                for (int c = 0; c < num_consumers; ++c)
+                    queue.push(Item{ SENTINEL, 0 });
+            }
+        });
+    }
+
+    state.resume_timing();
+    go.store(true, std::memory_order_release);
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    state.pause_timing();
+
+    std::vector<int64_t> all;
+    for (auto & local : latencies) {
+        all.insert(all.end(), local.begin(), local.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    if (all.size() != items_per_producer * num_producers) {
+        throw std::runtime_error("Queue lost or duplicated items!");
+    }
+
+    auto percentile = [&all](double p) {
+        return (double)all[std::min(all.size() - 1, (size_t)(p * all.size()))];
+    };
+
+    state.add_counter("p50_ns", percentile(0.50));
+    state.add_counter("p99_ns", percentile(0.99));
+    state.add_counter("p99.9_ns", percentile(0.999));
+    state.add_counter("max_ns", (double)all.back());
+}
+
+struct UnpaddedCounter {
+    std::atomic<uint64_t> value;
+};
+
+struct alignas(CACHE_LINE_SIZE) PaddedCounter {
+    std::atomic<uint64_t> value;
+};
+
+// Every thread increments only its own counter. With UnpaddedCounter neighbouring counters share a
+// cache line, so the line ping-pongs between cores even though no data is logically shared.
+template <typename Counter>
+void false_sharing_run(bench::State & state, int num_threads, uint64_t increments) {
+    state.pause_timing();
+
+    std::vector<Counter> counters(num_threads);
+    for (auto & counter : counters) {
+        counter.value.store(0);
+    }
+
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&counters, &go, increments, t]() {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (uint64_t k = 0; k < increments; ++k) {
+                counters[t].value.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    state.resume_timing();
+    go.store(true, std::memory_order_release);
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    state.pause_timing();
+
+    for (auto & counter : counters) {
+        if (counter.value.load() != increments) {
+            throw std::runtime_error("Counter mismatch!");
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[items_per_producer] [max_threads]");
+    if (harness.args().size() > 2) {
+        return harness.usage_error();
+    }
+
+    const uint64_t items_per_producer = harness.args().size() > 0 ? std::stoull(harness.args()[0]) : 1000000;
+    const int hardware_threads = std::max(2u, std::thread::hardware_concurrency());
+    const int max_threads = harness.args().size() > 1 ? std::stoi(harness.args()[1]) : hardware_threads;
+
+    harness.log() << "Items per producer: " << items_per_producer << ", queue capacity: " << QUEUE_CAPACITY << std::endl;
+
+    harness.run("SPSC 1P/1C", [&](bench::State & state) {
+        run_queue<SpscQueue<Item>>(state, 1, 1, items_per_producer);
+    }, items_per_producer);
+
+    // Waiting threads spin on yield, so shapes with more threads than the machine has would measure
+    // the scheduler rather than the queue.
+    for (int producers = 1; producers <= max_threads; producers *= 2) {
+        for (int consumers = 1; consumers <= max_threads && producers + consumers <= hardware_threads; consumers *= 2) {
+            const std::string shape = " " + std::to_string(producers) + "P/" + std::to_string(consumers) + "C";
+            const double items = (double)items_per_producer * producers;
+            harness.run("MPMC" + shape, [&](bench::State & state) {
+                run_queue<MpmcQueue<Item>>(state, producers, consumers, items_per_producer);
+            }, items);
+            harness.run("Mutex" + shape, [&](bench::State & state) {
+                run_queue<MutexQueue<Item>>(state, producers, consumers, items_per_producer);
+            }, items);
+        }
+    }
+
+    const uint64_t increments = items_per_producer * 10;
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        const std::string shape = " " + std::to_string(threads) + " threads";
+        harness.run("false sharing unpadded" + shape, [&](bench::State & state) {
+            false_sharing_run<UnpaddedCounter>(state, threads, increments);
+        }, (double)threads * increments, "increments");
+        harness.run("false sharing padded" + shape, [&](bench::State & state) {
+            false_sharing_run<PaddedCounter>(state, threads, increments);
+        }, (double)threads * increments, "increments");
+    }
+
+    return 0;
+}
@@ -1,114 +1,115 @@
-#include <chrono>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "asmlib.h"
+#include "bench_harness.h"
 
 namespace {
+    const size_t MB = 1048576ull;
     const size_t GB = 1073741824ull;
-    const size_t arr_size = GB * 1ull;
+
+    const size_t HOT_MAX_BLOCK = 512;
+    const int HOT_COPIES = 1024;
 }
 
-void large_memcpy_copy(char * arr) {
-    auto start = std::chrono::steady_clock::now();
+void large_memcpy_copy(char * arr, size_t arr_size) {
     std::memcpy(&arr[arr_size/2], &arr[0], arr_size/2);
-    auto stop = std::chrono::steady_clock::now();
-    auto time_taken = stop - start;
+    bench::clobber_memory();
+}
 
-    uint64_t accum = 0;
-    for (uint64_t k = 0; k < arr_size; ++k) {
-        accum += arr[k];
+// The last block is cut short when block_size doesn't divide arr_size/2.
+void small_memcpy_copy(char * arr, size_t arr_size, uint64_t block_size) {
+    for (uint64_t k = 0; k < arr_size/2; k+=block_size) {
+        std::memcpy(&arr[k+arr_size/2], &arr[k], std::min<uint64_t>(block_size, arr_size/2 - k));
     }
-    std::cout << accum << std::endl;
+    bench::clobber_memory();
+}
 
-    std::cout << "Time taken (large memcpy): " << std::chrono::duration_cast<std::chrono::milliseconds>(time_taken).count() << " milliseconds" << std::endl;
-    std::cout << "Bandwidth: " << (arr_size/2) / (std::chrono::duration_cast<std::chrono::nanoseconds>(time_taken).count() / (double)1000000000) / (1048576) << " MB/s" << std::endl;
+void A_large_memcpy_copy(char * arr, size_t arr_size) {
+    A_memcpy(&arr[arr_size/2], &arr[0], arr_size/2);
+    bench::clobber_memory();
 }
 
-void small_memcpy_copy(char * arr, uint64_t block_size) {
-    auto start = std::chrono::steady_clock::now();
+void A_small_memcpy_copy(char * arr, size_t arr_size, uint64_t block_size) {
     for (uint64_t k = 0; k < arr_size/2; k+=block_size) {
-        std::memcpy(&arr[k+arr_size/2], &arr[k], block_size);
+        A_memcpy(&arr[k+arr_size/2], &arr[k], std::min<uint64_t>(block_size, arr_size/2 - k));
     }
-    auto stop = std::chrono::steady_clock::now();
-    auto time_taken = stop - start;
+    bench::clobber_memory();
+}
 
-    uint64_t accum = 0;
-    for (uint64_t k = 0; k < arr_size; ++k) {
-        accum += arr[k];
+// Repeatedly copies one small cache-resident block: the per-call cost of a small copy rather than
+// bandwidth. Run with --timer=tsc for cycles per copy.
+void hot_memcpy_copy(char * dst, const char * src, size_t block_size) {
+    for (int k = 0; k < HOT_COPIES; ++k) {
+        std::memcpy(dst, src, block_size);
+        bench::clobber_memory();
     }
-
-    std::cout << block_size << " Bandwidth: " << (arr_size/2) / (std::chrono::duration_cast<std::chrono::nanoseconds>(time_taken).count() / (double)1000000000) / (1048576) << " MB/s " << accum << std::endl;
 }
 
-void A_large_memcpy_copy(char * arr) {
-    auto start = std::chrono::steady_clock::now();
-    A_memcpy(&arr[arr_size/2], &arr[0], arr_size/2);
-    auto stop = std::chrono::steady_clock::now();
-    auto time_taken = stop - start;
-
-    uint64_t accum = 0;
-    for (uint64_t k = 0; k < arr_size; ++k) {
-        accum += arr[k];
+void A_hot_memcpy_copy(char * dst, const char * src, size_t block_size) {
+    for (int k = 0; k < HOT_COPIES; ++k) {
+        A_memcpy(dst, src, block_size);
+        bench::clobber_memory();
     }
-    std::cout << accum << std::endl;
-
-    std::cout << "Time taken (large memcpy): " << std::chrono::duration_cast<std::chrono::milliseconds>(time_taken).count() << " milliseconds" << std::endl;
-    std::cout << "Bandwidth: " << (arr_size/2) / (std::chrono::duration_cast<std::chrono::nanoseconds>(time_taken).count() / (double)1000000000) / (1048576) << " MB/s" << std::endl;
 }
 
-void A_small_memcpy_copy(char * arr, uint64_t block_size) {
-    auto start = std::chrono::steady_clock::now();
-    for (uint64_t k = 0; k < arr_size/2; k+=block_size) {
-        A_memcpy(&arr[k+arr_size/2], &arr[k], block_size);
-    }
-    auto stop = std::chrono::steady_clock::now();
-    auto time_taken = stop - start;
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[array_MB] [num_threads]");
+    if (harness.args().size() > 2)
+        return harness.usage_error();
 
-    uint64_t accum = 0;
-    for (uint64_t k = 0; k < arr_size; ++k) {
-        accum += arr[k];
-    }
+    const size_t arr_size = harness.args().size() > 0 ? std::stoull(harness.args()[0]) * MB : GB;
+    const int num_threads = harness.args().size() > 1 ? std::stoi(harness.args()[1]) : 8;
 
-    std::cout << block_size << " Bandwidth: " << (arr_size/2) / (std::chrono::duration_cast<std::chrono::nanoseconds>(time_taken).count() / (double)1000000000) / (1048576) << " MB/s " << accum << std::endl;
-}
+    harness.log() << "Array size: " << arr_size << std::endl;
 
-int main() {
-    std::cout << "Array size: " << arr_size << std::endl;
-auto memcpy_threadproc = [](){
-    char * arr1 = new char[arr_size];
+    {
+        std::vector<char> hot_src(HOT_MAX_BLOCK, 1);
+        std::vector<char> hot_dst(HOT_MAX_BLOCK);
+        for (size_t k = 8; k <= HOT_MAX_BLOCK; k *= 2) {
+            harness.run("memcpy hot " + std::to_string(k) + "B", [&]() { hot_memcpy_copy(hot_dst.data(), hot_src.data(), k); }, HOT_COPIES, "copies");
+            harness.run("A_memcpy hot " + std::to_string(k) + "B", [&]() { A_hot_memcpy_copy(hot_dst.data(), hot_src.data(), k); }, HOT_COPIES, "copies");
+        }
+    }
 
+    char * arr1 = new char[arr_size];
     std::memset(arr1, 1, arr_size);
 
-//    large_memcpy_copy(arr1);
-//    std::cout << std::endl;
-//    for (uint64_t k = 1; k <= GB; k *= 2) {
-//        small_memcpy_copy(arr1, k);
-//    }
-//    std::cout << std::endl;
-//    large_memcpy_copy(arr1);
-//    std::cout << std::endl;
-
-    while (true)
-        A_large_memcpy_copy(arr1);
-//    std::cout << std::endl;
-//    for (uint64_t k = 1; k <= GB; k *= 2) {
-//        A_small_memcpy_copy(arr1, k);
-//    }
-//    std::cout << std::endl;
-//    A_large_memcpy_copy(arr1);
+    harness.run("memcpy large", [&]() { large_memcpy_copy(arr1, arr_size); }, arr_size/2, "bytes");
+    harness.run("A_memcpy large", [&]() { A_large_memcpy_copy(arr1, arr_size); }, arr_size/2, "bytes");
+
+    for (uint64_t k = 1; k <= arr_size/2; k *= 2) {
+        harness.run("memcpy block " + std::to_string(k), [&]() { small_memcpy_copy(arr1, arr_size, k); }, arr_size/2, "bytes");
+        harness.run("A_memcpy block " + std::to_string(k), [&]() { A_small_memcpy_copy(arr1, arr_size, k); }, arr_size/2, "bytes");
+    }
 
     delete[] arr1;
-};
 
-    std::vector<std::thread> thread_vec;
-    for (int i = 0; i < 8; ++i) {
-        thread_vec.emplace_back(memcpy_threadproc);
+    // Every thread copies within its own array, so this measures aggregate memory bandwidth.
+    std::vector<char *> thread_arrays;
+    for (int i = 0; i < num_threads; ++i) {
+        thread_arrays.push_back(new char[arr_size]);
+        std::memset(thread_arrays.back(), 1, arr_size);
     }
 
-    for (int i = 0; i < 8; ++i) {
-        thread_vec[i].join();
+    harness.run("A_memcpy large x" + std::to_string(num_threads) + " threads", [&]() {
+        std::vector<std::thread> thread_vec;
+        for (int i = 0; i < num_threads; ++i) {
+            thread_vec.emplace_back([&thread_arrays, arr_size, i]() {
+                A_large_memcpy_copy(thread_arrays[i], arr_size);
+            });
+        }
+
+        for (auto & thread : thread_vec) {
+            thread.join();
+        }
+    }, (double)num_threads * (arr_size/2), "bytes");
+
+    for (char * arr : thread_arrays) {
+        delete[] arr;
     }
 }
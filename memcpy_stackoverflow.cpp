@@ -1,36 +1,11 @@
-#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <cstdint>
+#include <stdexcept>
+#include <string>
 
-class Timer
-{
- public:
-  Timer()
-      : mStart(),
-        mStop()
-  {
-    update();
-  }
-
-  void update()
-  {
-    mStart = std::chrono::high_resolution_clock::now();
-    mStop  = mStart;
-  }
-
-  double elapsedMs()
-  {
-    mStop = std::chrono::high_resolution_clock::now();
-    std::chrono::milliseconds elapsed_ms =
-        std::chrono::duration_cast<std::chrono::milliseconds>(mStop - mStart);
-    return elapsed_ms.count();
-  }
-
- private:
-  std::chrono::high_resolution_clock::time_point mStart;
-  std::chrono::high_resolution_clock::time_point mStop;
-};
+#include "bench_harness.h"
 
 std::string formatBytes(std::uint64_t bytes)
 {
@@ -67,60 +42,61 @@ void doMemmove(void* pDest, const void* pSource, std::size_t sizeBytes)
 
 int main(int argc, char* argv[])
 {
+  bench::Harness harness(argc, argv, "[SIZE_BYTES]");
   std::uint64_t SIZE_BYTES = 1073741824; // 1GB
 
-  if (argc > 1)
+  if (harness.args().size() > 1)
   {
-    SIZE_BYTES = std::stoull(argv[1]);
-    std::cout << "Using buffer size from command line: " << formatBytes(SIZE_BYTES)
-              << std::endl;
+    return harness.usage_error();
+  }
+  else if (harness.args().size() == 1)
+  {
+    SIZE_BYTES = std::stoull(harness.args()[0]);
+    harness.log() << "Using buffer size from command line: " << formatBytes(SIZE_BYTES)
+                  << std::endl;
   }
   else
   {
-    std::cout << "To specify a custom buffer size: big_memcpy_test [SIZE_BYTES] \n"
-              << "Using built in buffer size: " << formatBytes(SIZE_BYTES)
-              << std::endl;
+    harness.log() << "To specify a custom buffer size: big_memcpy_test [SIZE_BYTES] \n"
+                  << "Using built in buffer size: " << formatBytes(SIZE_BYTES)
+                  << std::endl;
   }
 
 
-  // big array to use for testing
-  char* p_big_array = NULL;
-
   /////////////
-  // malloc 
+  // malloc
+  harness.run("malloc", [SIZE_BYTES](bench::State& state)
   {
-    Timer timer;
-
-    p_big_array = (char*)malloc(SIZE_BYTES * sizeof(char));
-    if (p_big_array == NULL)
+    char* p_array = (char*)malloc(SIZE_BYTES * sizeof(char));
+    if (p_array == NULL)
     {
-      std::cerr << "ERROR: malloc of " << SIZE_BYTES << " returned NULL!"
-                << std::endl;
-      return 1;
+      throw std::runtime_error("malloc of " + std::to_string(SIZE_BYTES) + " returned NULL!");
     }
+    bench::do_not_optimize(p_array);
+
+    state.pause_timing();
+    free(p_array);
+  });
 
-    std::cout << "malloc for " << formatBytes(SIZE_BYTES) << " took "
-              << timer.elapsedMs() << "ms"
+  // big array to use for testing
+  char* p_big_array = (char*)malloc(SIZE_BYTES * sizeof(char));
+  if (p_big_array == NULL)
+  {
+    std::cerr << "ERROR: malloc of " << SIZE_BYTES << " returned NULL!"
               << std::endl;
+    return 1;
   }
 
   /////////////
   // memset
+  harness.run("memset", [&]()
   {
-    Timer timer;
-
-    // set all data in p_big_array to 0
     memset(p_big_array, 0xF, SIZE_BYTES * sizeof(char));
-
-    double elapsed_ms = timer.elapsedMs();
-    std::cout << "memset for " << formatBytes(SIZE_BYTES) << " took "
-              << elapsed_ms << "ms "
-              << "(" << formatBytes(SIZE_BYTES / (elapsed_ms / 1.0e3)) << " bytes/sec)"
-              << std::endl;
-  }
+    bench::clobber_memory();
+  }, SIZE_BYTES, "bytes");
 
   /////////////
-  // memcpy 
+  // memcpy
   {
     char* p_dest_array = (char*)malloc(SIZE_BYTES);
     if (p_dest_array == NULL)
@@ -133,15 +109,11 @@ int main(int argc, char* argv[])
     memset(p_dest_array, 0xF, SIZE_BYTES * sizeof(char));
 
     // time only the memcpy FROM p_big_array TO p_dest_array
-    Timer timer;
-
-    memcpy(p_dest_array, p_big_array, SIZE_BYTES * sizeof(char));
-
-    double elapsed_ms = timer.elapsedMs();
-    std::cout << "memcpy for " << formatBytes(SIZE_BYTES) << " took "
-              << elapsed_ms << "ms "
-              << "(" << formatBytes(SIZE_BYTES / (elapsed_ms / 1.0e3)) << " bytes/sec)"
-              << std::endl;
+    harness.run("memcpy", [&]()
+    {
+      memcpy(p_dest_array, p_big_array, SIZE_BYTES * sizeof(char));
+      bench::clobber_memory();
+    }, SIZE_BYTES, "bytes");
 
     // cleanup p_dest_array
     free(p_dest_array);
@@ -162,16 +134,11 @@ int main(int argc, char* argv[])
     memset(p_dest_array, 0xF, SIZE_BYTES * sizeof(char));
 
     // time only the memmove FROM p_big_array TO p_dest_array
-    Timer timer;
-
-    // memmove(p_dest_array, p_big_array, SIZE_BYTES * sizeof(char));
-    doMemmove(p_dest_array, p_big_array, SIZE_BYTES * sizeof(char));
-
-    double elapsed_ms = timer.elapsedMs();
-    std::cout << "memmove for " << formatBytes(SIZE_BYTES) << " took "
-              << elapsed_ms << "ms "
-              << "(" << formatBytes(SIZE_BYTES / (elapsed_ms / 1.0e3)) << " bytes/sec)"
-              << std::endl;
+    harness.run("memmove", [&]()
+    {
+      doMemmove(p_dest_array, p_big_array, SIZE_BYTES * sizeof(char));
+      bench::clobber_memory();
+    }, SIZE_BYTES, "bytes");
 
     // cleanup p_dest_array
     free(p_dest_array);
@@ -184,4 +151,4 @@ int main(int argc, char* argv[])
   p_big_array = NULL;
 
   return 0;
-}
\ No newline at end of file
+}
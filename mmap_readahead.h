@@ -0,0 +1,137 @@
+#ifndef MMAP_READAHEAD_H
+#define MMAP_READAHEAD_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Readahead stage for a file mapping consumed front to back by several workers.
+//
+// Each worker reports the offset of the block it is working on. A background thread follows the
+// slowest worker: it keeps MADV_WILLNEED issued for window bytes past that worker, so pages are read
+// in before anyone faults on them, and drops everything behind it with MADV_DONTNEED on the mapping and
+// POSIX_FADV_DONTNEED on the file, so the resident footprint stays around one window instead of the
+// whole file.
+class MmapReadahead {
+public:
+    MmapReadahead(const std::string & filename, const char * base, uint64_t size, uint64_t window_bytes, int num_workers)
+        : base_(base), size_(size), window_(std::max<uint64_t>(window_bytes, page_size())),
+          step_(std::max(window_ / 4 / page_size() * page_size(), page_size())), cursors_(num_workers), notified_step_(0),
+          stopping_(false), advised_until_(0), dropped_until_(0), willneed_bytes_(0), dontneed_bytes_(0) {
+        fd_ = open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open " + filename + " for readahead!");
+        }
+        for (auto & cursor : cursors_) {
+            cursor = 0;
+        }
+        advance(0);
+        thread_ = std::thread(&MmapReadahead::run, this);
+    }
+
+    ~MmapReadahead() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+        close(fd_);
+    }
+
+    MmapReadahead(const MmapReadahead &) = delete;
+    MmapReadahead & operator=(const MmapReadahead &) = delete;
+
+    // Worker is now at offset; pass the file size when it has no more blocks. The readahead thread is
+    // only woken when the slowest worker has moved into a new step, since otherwise it has nothing to do.
+    void update(int worker, uint64_t offset) {
+        cursors_[worker].store(offset, std::memory_order_relaxed);
+        const uint64_t slowest = slowest_cursor();
+        const uint64_t step = slowest == size_ ? UINT64_MAX : slowest / step_;
+        if (notified_step_.exchange(step, std::memory_order_relaxed) != step)
+            wake_.notify_one();
+    }
+
+    // Bytes advised so far, reported with the readahead runs.
+    uint64_t willneed_bytes() const { return willneed_bytes_; }
+    uint64_t dontneed_bytes() const { return dontneed_bytes_; }
+
+private:
+    static uint64_t page_size() {
+        return (uint64_t)sysconf(_SC_PAGESIZE);
+    }
+
+    uint64_t slowest_cursor() const {
+        uint64_t slowest = size_;
+        for (const auto & cursor : cursors_) {
+            slowest = std::min(slowest, cursor.load(std::memory_order_relaxed));
+        }
+        return slowest;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            // Timed wait: a notify can slip in between checking the cursors and waiting.
+            wake_.wait_for(lock, std::chrono::milliseconds(1));
+            lock.unlock();
+            advance(slowest_cursor());
+            lock.lock();
+        }
+    }
+
+    // Advice is issued in steps of a quarter window so it costs a few syscalls per window, not per block.
+    void advance(uint64_t slowest) {
+        const uint64_t page = page_size();
+        const uint64_t step = step_;
+
+        const uint64_t want_until = std::min(size_, slowest + window_);
+        if (want_until >= std::min(size_, advised_until_ + step) && want_until > advised_until_) {
+            const uint64_t begin = advised_until_ / page * page;
+            madvise((void *)(base_ + begin), want_until - begin, MADV_WILLNEED);
+            willneed_bytes_ += want_until - advised_until_;
+            advised_until_ = want_until;
+        }
+
+        const uint64_t drop_until = slowest / page * page;
+        if (drop_until >= dropped_until_ + step || (slowest == size_ && drop_until > dropped_until_)) {
+            madvise((void *)(base_ + dropped_until_), drop_until - dropped_until_, MADV_DONTNEED);
+            posix_fadvise(fd_, dropped_until_, drop_until - dropped_until_, POSIX_FADV_DONTNEED);
+            dontneed_bytes_ += drop_until - dropped_until_;
+            dropped_until_ = drop_until;
+        }
+    }
+
+    const char * base_;
+    const uint64_t size_;
+    const uint64_t window_;
+    const uint64_t step_;
+    int fd_;
+
+    std::vector<std::atomic<uint64_t>> cursors_;
+    std::atomic<uint64_t> notified_step_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+    std::thread thread_;
+
+    // Only touched by the readahead thread after construction.
+    uint64_t advised_until_;
+    uint64_t dropped_until_;
+    std::atomic<uint64_t> willneed_bytes_;
+    std::atomic<uint64_t> dontneed_bytes_;
+};
+
+#endif // MMAP_READAHEAD_H
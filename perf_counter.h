@@ -0,0 +1,176 @@
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// One hardware/software counter for the calling thread, opened with perf_event_open. When the kernel
+// refuses (no PMU in a VM, perf_event_paranoid, non-Linux host) valid() is false and read() returns 0,
+// so callers can print "n/a" instead of failing.
+//
+// With inherit set, threads created by the calling thread while the counter exists are counted too;
+// their counts are folded in when they exit, so join them before read(). When more events are open
+// than the PMU has counters the kernel time-multiplexes them, and read() scales the raw count by
+// enabled/running time to estimate the full-interval value.
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config, bool inherit = false): fd_(-1) {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = inherit;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd_ = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        (void)type;
+        (void)config;
+        (void)inherit;
+#endif
+    }
+
+    ~PerfCounter() {
+#ifdef __linux__
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+
+    PerfCounter(const PerfCounter &) = delete;
+    PerfCounter & operator=(const PerfCounter &) = delete;
+
+    bool valid() const {
+        return fd_ >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Continues counting after stop() without clearing the count.
+    void resume() {
+#ifdef __linux__
+        if (fd_ >= 0)
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        if (fd_ >= 0)
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    uint64_t read() const {
+#ifdef __linux__
+        // value, time_enabled, time_running
+        uint64_t values[3] = { 0, 0, 0 };
+        if (fd_ < 0 || ::read(fd_, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+            return 0;
+        if (values[2] < values[1])
+            return (uint64_t)((double)values[0] * values[1] / values[2]);
+        return values[0];
+#else
+        return 0;
+#endif
+    }
+
+private:
+    int fd_;
+};
+
+// The standard set of counters for explaining a throughput number: cycles, instructions, LLC misses,
+// dTLB load misses, branch misses and page faults, all inherited by threads spawned while counting.
+// Events the machine does not support are left out; available() is false only if none could be opened.
+class PerfCounterSet {
+public:
+    PerfCounterSet() {
+#ifdef __linux__
+        add("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        add("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add("LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        add("dTLB-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        add("branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        add("page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#endif
+    }
+
+    bool available() const {
+        return !counters_.empty();
+    }
+
+    // Names of the events that could not be opened.
+    const std::vector<std::string> & unavailable() const {
+        return unavailable_;
+    }
+
+    void start() {
+        for (auto & counter : counters_)
+            counter.second->start();
+    }
+
+    void resume() {
+        for (auto & counter : counters_)
+            counter.second->resume();
+    }
+
+    void stop() {
+        for (auto & counter : counters_)
+            counter.second->stop();
+    }
+
+    // Counts since the last start(), plus IPC when both cycles and instructions were counted.
+    std::vector<std::pair<std::string, double>> read() const {
+        std::vector<std::pair<std::string, double>> values;
+        double cycles = 0;
+        double instructions = 0;
+        for (const auto & counter : counters_) {
+            const double value = (double)counter.second->read();
+            values.emplace_back(counter.first, value);
+            if (counter.first == "cycles")
+                cycles = value;
+            else if (counter.first == "instructions")
+                instructions = value;
+        }
+        if (cycles > 0 && instructions > 0)
+            values.emplace_back("IPC", instructions / cycles);
+        return values;
+    }
+
+private:
+    void add(const std::string & name, uint32_t type, uint64_t config) {
+        std::unique_ptr<PerfCounter> counter(new PerfCounter(type, config, true));
+        if (counter->valid())
+            counters_.emplace_back(name, std::move(counter));
+        else
+            unavailable_.push_back(name);
+    }
+
+    std::vector<std::pair<std::string, std::unique_ptr<PerfCounter>>> counters_;
+    std::vector<std::string> unavailable_;
+};
+
+#endif // PERF_COUNTER_H
@@ -0,0 +1,152 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Vector with room for N elements inside the object itself. Elements live in the inline buffer until
+// the (N+1)th push_back, at which point everything moves to a heap block that then grows
+// geometrically like std::vector. Moving a spilled small_vector steals the heap block; moving an
+// inline one has to move the elements.
+template <typename T, size_t N>
+class small_vector {
+public:
+    typedef T value_type;
+    typedef T * iterator;
+    typedef const T * const_iterator;
+
+    small_vector(): data_(inline_data()), size_(0), capacity_(N) {}
+
+    small_vector(const small_vector & other): small_vector() {
+        reserve(other.size_);
+        std::uninitialized_copy(other.begin(), other.end(), data_);
+        size_ = other.size_;
+    }
+
+    small_vector(small_vector && other) noexcept(std::is_nothrow_move_constructible<T>::value): small_vector() {
+        steal(std::move(other));
+    }
+
+    small_vector & operator=(const small_vector & other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size_);
+            std::uninitialized_copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    small_vector & operator=(small_vector && other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if (this != &other) {
+            clear();
+            release_heap();
+            steal(std::move(other));
+        }
+        return *this;
+    }
+
+    ~small_vector() {
+        clear();
+        release_heap();
+    }
+
+    void push_back(const T & value) {
+        emplace_back(value);
+    }
+
+    void push_back(T && value) {
+        emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    T & emplace_back(Args &&... args) {
+        if (size_ == capacity_)
+            grow(std::max<size_t>(1, capacity_ * 2));
+        T * slot = ::new(static_cast<void *>(data_ + size_)) T(std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+
+    void pop_back() {
+        data_[--size_].~T();
+    }
+
+    void reserve(size_t capacity) {
+        if (capacity > capacity_)
+            grow(capacity);
+    }
+
+    void clear() {
+        for (size_t k = 0; k < size_; ++k)
+            data_[k].~T();
+        size_ = 0;
+    }
+
+    bool is_inline() const { return data_ == inline_data(); }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    T * data() { return data_; }
+    const T * data() const { return data_; }
+    T & operator[](size_t index) { return data_[index]; }
+    const T & operator[](size_t index) const { return data_[index]; }
+
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+private:
+    T * inline_data() { return reinterpret_cast<T *>(&inline_storage_); }
+    const T * inline_data() const { return reinterpret_cast<const T *>(&inline_storage_); }
+
+    void grow(size_t capacity) {
+        T * heap = static_cast<T *>(::operator new(capacity * sizeof(T)));
+        for (size_t k = 0; k < size_; ++k) {
+            ::new(static_cast<void *>(heap + k)) T(std::move_if_noexcept(data_[k]));
+            data_[k].~T();
+        }
+        release_heap();
+        data_ = heap;
+        capacity_ = capacity;
+    }
+
+    void release_heap() {
+        if (!is_inline()) {
+            ::operator delete(data_);
+            data_ = inline_data();
+            capacity_ = N;
+        }
+    }
+
+    // Expects *this to be empty and inline.
+    void steal(small_vector && other) {
+        if (other.is_inline()) {
+            for (size_t k = 0; k < other.size_; ++k)
+                ::new(static_cast<void *>(data_ + k)) T(std::move(other.data_[k]));
+            size_ = other.size_;
+            other.clear();
+        } else {
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_data();
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+    }
+
+    T * data_;
+    size_t size_;
+    size_t capacity_;
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type inline_storage_;
+};
+
+#endif // SMALL_VECTOR_H
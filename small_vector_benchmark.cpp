@@ -0,0 +1,144 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "perf_counter.h"
+#include "small_vector.h"
+
+namespace {
+    const size_t INLINE_CAPACITY = 16;
+    const int MAX_RECORD_SIZE = 64;
+    const int ITERATE_PASSES = 10;
+}
+
+// std::vector that reserves the inline capacity up front, the usual hand-optimization for tiny vectors.
+class ReservedVector : public std::vector<int> {
+public:
+    ReservedVector() {
+        reserve(INLINE_CAPACITY);
+    }
+};
+
+// Fixed std::array plus a size field. It cannot spill, so it is sized for the largest record.
+template <typename T, size_t N>
+class ArrayVector {
+public:
+    ArrayVector(): size_(0) {}
+
+    void push_back(const T & value) {
+        if (size_ == N)
+            throw std::length_error("ArrayVector is full!");
+        data_[size_++] = value;
+    }
+
+    size_t size() const { return size_; }
+    T & operator[](size_t index) { return data_[index]; }
+    const T * begin() const { return data_.data(); }
+    const T * end() const { return data_.data() + size_; }
+
+private:
+    std::array<T, N> data_;
+    uint32_t size_;
+};
+
+// Runs proc under the harness and reports the cache misses it caused per operation, when available.
+template <typename Proc>
+void measure(bench::Harness & harness, const std::string & name, PerfCounter & cache_misses, uint64_t ops, Proc proc) {
+    harness.run(name, [&](bench::State & state) {
+        cache_misses.start();
+        proc();
+        cache_misses.stop();
+        if (cache_misses.valid())
+            state.add_counter("cache-misses/op", (double)cache_misses.read() / ops);
+    }, ops);
+}
+
+template <typename Container>
+void run_container(bench::Harness & harness, const std::string & name, const std::vector<int> & record_sizes) {
+    PerfCounter cache_misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    uint64_t total_elements = 0;
+    for (int size : record_sizes) {
+        total_elements += size;
+    }
+
+    // push_back-heavy: build and drop one container per record.
+    measure(harness, name + " push_back", cache_misses, total_elements, [&record_sizes]() {
+        uint64_t accum = 0;
+        for (int size : record_sizes) {
+            Container record;
+            for (int k = 0; k < size; ++k) {
+                record.push_back(k);
+            }
+            accum += record.size() + record[size - 1];
+        }
+        bench::do_not_optimize(accum);
+    });
+
+    std::vector<Container> records(record_sizes.size());
+    for (size_t r = 0; r < record_sizes.size(); ++r) {
+        for (int k = 0; k < record_sizes[r]; ++k) {
+            records[r].push_back(k);
+        }
+    }
+
+    // copy/move-heavy: copy every record, then move every copy into a new collection.
+    measure(harness, name + " copy/move", cache_misses, records.size() * 2, [&records]() {
+        std::vector<Container> copies(records);
+        std::vector<Container> moved;
+        moved.reserve(copies.size());
+        for (auto & record : copies) {
+            moved.push_back(std::move(record));
+        }
+        bench::do_not_optimize(moved.back().size());
+    });
+
+    // iterate-heavy: repeatedly walk every element of every record.
+    measure(harness, name + " iterate", cache_misses, total_elements * ITERATE_PASSES, [&records]() {
+        uint64_t accum = 0;
+        for (int pass = 0; pass < ITERATE_PASSES; ++pass) {
+            for (const auto & record : records) {
+                for (int value : record) {
+                    accum += value;
+                }
+            }
+        }
+        bench::do_not_optimize(accum);
+    });
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[num_records] [percent_spilling]");
+    if (harness.args().size() > 2) {
+        return harness.usage_error();
+    }
+
+    const size_t num_records = harness.args().size() > 0 ? std::stoull(harness.args()[0]) : 1000000;
+    const int percent_spilling = harness.args().size() > 1 ? std::stoi(harness.args()[1]) : 10;
+
+    // Most records fit in the inline capacity; percent_spilling of them are larger and force a spill.
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::bernoulli_distribution spill(percent_spilling / 100.0);
+    std::uniform_int_distribution<> small_size(1, INLINE_CAPACITY);
+    std::uniform_int_distribution<> large_size(INLINE_CAPACITY + 1, MAX_RECORD_SIZE);
+
+    std::vector<int> record_sizes(num_records);
+    for (auto & size : record_sizes) {
+        size = spill(gen) ? large_size(gen) : small_size(gen);
+    }
+
+    harness.log() << num_records << " records, " << percent_spilling << "% larger than " << INLINE_CAPACITY << " elements" << std::endl;
+
+    run_container<std::vector<int>>(harness, "std::vector", record_sizes);
+    run_container<ReservedVector>(harness, "std::vector + reserve", record_sizes);
+    run_container<ArrayVector<int, MAX_RECORD_SIZE>>(harness, "std::array + size", record_sizes);
+    run_container<small_vector<int, INLINE_CAPACITY>>(harness, "small_vector<int, 16>", record_sizes);
+
+    return 0;
+}
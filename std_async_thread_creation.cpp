@@ -1,19 +1,23 @@
 #include <future>
-#include <chrono>
 #include <vector>
 #include <string>
-#include <iostream>
+
+#include "bench_harness.h"
 
 int main(int argc, char * argv[]) {
-	auto begin = std::chrono::high_resolution_clock::now();
-	std::vector<std::future<void>> futures;
-	for (int k = 0; k < std::stoi(argv[1]); ++k) {
-		futures.emplace_back(std::async(std::launch::async, [](){}));
-	}
+	bench::Harness harness(argc, argv, "num_threads");
+	if (harness.args().size() != 1)
+		return harness.usage_error();
+
+	const int num_threads = std::stoi(harness.args()[0]);
+	harness.run("std::async launch+wait", [num_threads]() {
+		std::vector<std::future<void>> futures;
+		for (int k = 0; k < num_threads; ++k) {
+			futures.emplace_back(std::async(std::launch::async, [](){}));
+		}
 
-	for (auto & future: futures) {
-		future.wait();
-	}
-	auto end = std::chrono::high_resolution_clock::now();
-	std::cout << "Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " milliseconds" << std::endl;
-}
\ No newline at end of file
+		for (auto & future: futures) {
+			future.wait();
+		}
+	}, num_threads, "threads");
+}
@@ -1,56 +1,252 @@
-#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <random>
+#include <string>
+#include <vector>
 
-int unconditional_clear(int resize_iterations, std::uniform_int_distribution<> & dist, std::mt19937 & gen) {
-    std::vector<int> vec;
-    
-    auto begin = std::chrono::high_resolution_clock::now();
+#include "bench_harness.h"
+
+namespace {
+    // Every heap allocation in the process goes through the replaced operator new overloads below,
+    // including the upstream allocations of the pmr resources: libstdc++'s new_delete_resource calls the
+    // aligned operator new, so that overload is replaced too.
+    uint64_t allocation_count = 0;
+
+    const size_t SIZE_TABLE_LENGTH = 1 << 20;
+}
+
+void * operator new(std::size_t size) {
+    ++allocation_count;
+    if (void * ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void * operator new(std::size_t size, std::align_val_t align) {
+    ++allocation_count;
+    const std::size_t alignment = static_cast<std::size_t>(align);
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    const std::size_t rounded = ((size ? size : 1) + alignment - 1) / alignment * alignment;
+    if (void * ptr = std::aligned_alloc(alignment, rounded))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+// Allocator adaptor that default-initializes instead of value-initializing, so resize() on a
+// vector of trivial types leaves the new elements uninitialized rather than zero-filling them.
+template <typename T, typename A = std::allocator<T>>
+class default_init_allocator : public A {
+    typedef std::allocator_traits<A> a_t;
+public:
+    template <typename U>
+    struct rebind {
+        using other = default_init_allocator<U, typename a_t::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+
+    template <typename U>
+    void construct(U * ptr) noexcept(std::is_nothrow_default_constructible<U>::value) {
+        ::new(static_cast<void *>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U * ptr, Args &&... args) {
+        a_t::construct(static_cast<A &>(*this), ptr, std::forward<Args>(args)...);
+    }
+};
+
+typedef std::vector<int, default_init_allocator<int>> uninitialized_vector;
+
+// Free list of vectors handed back after use, so buffers keep their capacity across records.
+template <typename Vec>
+class VectorPool {
+public:
+    Vec acquire() {
+        if (free_.empty())
+            return Vec();
+        Vec vec = std::move(free_.back());
+        free_.pop_back();
+        return vec;
+    }
+
+    void release(Vec && vec) {
+        vec.clear();
+        free_.push_back(std::move(vec));
+    }
+
+private:
+    std::vector<Vec> free_;
+};
+
+// Every variant hands its resized vector to this, so the compiler can't drop a zero-fill whose result
+// is never read and all variants do the same work.
+template <typename Vec>
+void consume(const Vec & vec) {
+    bench::do_not_optimize(vec.data());
+    bench::clobber_memory();
+}
+
+template <typename Proc>
+void resize_loop(bench::State & state, int resize_iterations, const std::vector<int> & sizes, Proc proc) {
+    const uint64_t allocations_before = allocation_count;
     for (int k = 0; k < resize_iterations; ++k) {
-        int size = dist(gen);
-        
+        proc(sizes[k & (SIZE_TABLE_LENGTH - 1)]);
+    }
+    state.add_counter("allocations/iteration", (double)(allocation_count - allocations_before) / resize_iterations);
+}
+
+void unconditional_clear(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    std::vector<int> vec;
+
+    resize_loop(state, resize_iterations, sizes, [&vec](int size) {
         vec.clear();
-        
+
         vec.resize(size);
-    }
-    auto end = std::chrono::high_resolution_clock::now();
-    
-    return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        consume(vec);
+    });
 }
 
-int conditional_clear(int resize_iterations, std::uniform_int_distribution<> & dist, std::mt19937 & gen) {
+void conditional_clear(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
     std::vector<int> vec;
-    
-    auto begin = std::chrono::high_resolution_clock::now();
-    for (int k = 0; k < resize_iterations; ++k) {
-        int size = dist(gen);
-        
+
+    resize_loop(state, resize_iterations, sizes, [&vec](int size) {
         if (size > vec.capacity())
             vec.clear();
-        
+
+        vec.resize(size);
+        consume(vec);
+    });
+}
+
+void fresh_vector(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    resize_loop(state, resize_iterations, sizes, [](int size) {
+        std::vector<int> vec;
         vec.resize(size);
+        consume(vec);
+    });
+}
+
+void uninitialized_resize(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    uninitialized_vector vec;
+
+    resize_loop(state, resize_iterations, sizes, [&vec](int size) {
+        vec.clear();
+
+        vec.resize(size);
+        consume(vec);
+    });
+}
+
+// Per-record arena: a fresh vector is carved out of a static buffer and the whole arena is released
+// at the end of each record. Only records bigger than the buffer reach the heap.
+void pmr_monotonic(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    alignas(std::max_align_t) static char arena[1 << 20];
+    std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena));
+
+    resize_loop(state, resize_iterations, sizes, [&resource](int size) {
+        {
+            std::pmr::vector<int> vec(&resource);
+            vec.resize(size);
+            consume(vec);
+        }
+        resource.release();
+    });
+}
+
+void pmr_pool(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    std::pmr::unsynchronized_pool_resource resource;
+
+    resize_loop(state, resize_iterations, sizes, [&resource](int size) {
+        std::pmr::vector<int> vec(&resource);
+        vec.resize(size);
+        consume(vec);
+    });
+}
+
+// Instantiated with std::vector<int> for the effect of reusing capacity alone, and with
+// uninitialized_vector for reuse combined with skipping the zero-fill.
+template <typename Vec>
+void reuse_pool(bench::State & state, int resize_iterations, const std::vector<int> & sizes) {
+    VectorPool<Vec> pool;
+
+    resize_loop(state, resize_iterations, sizes, [&pool](int size) {
+        Vec vec = pool.acquire();
+        vec.resize(size);
+        consume(vec);
+        pool.release(std::move(vec));
+    });
+}
+
+template <typename Dist>
+std::vector<int> generate_sizes(Dist dist, std::mt19937 & gen) {
+    std::vector<int> sizes(SIZE_TABLE_LENGTH);
+    for (auto & size : sizes) {
+        size = dist(gen);
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    
-    return std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+    return sizes;
 }
 
-int main() {
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "[resize_iterations]");
+    if (harness.args().size() > 1) {
+        return harness.usage_error();
+    }
+
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(1,500);
-    
-    int test_iterations = 10;
-    int resize_iterations = 100*1000*1000;
-    
-    double unconditional_sum = 0.0;
-    for (int k = 0; k < test_iterations; ++k)
-        unconditional_sum += unconditional_clear(resize_iterations, dist, gen);
-    
-    double conditional_sum = 0.0;
-    for (int k = 0; k < test_iterations; ++k)
-        conditional_sum += conditional_clear(resize_iterations, dist, gen);
-    
-    std::cout << "Unconditional avg execution time: " << unconditional_sum / test_iterations << " milliseconds" << std::endl;
-    std::cout << "Conditional avg execution time: " << conditional_sum / test_iterations << " milliseconds" << std::endl;
+
+    int resize_iterations = harness.args().size() > 0 ? std::stoi(harness.args()[0]) : 1000*1000;
+
+    // Sizes are drawn up front so the timed loops measure resizing rather than the RNG.
+    std::vector<std::pair<std::string, std::vector<int>>> distributions;
+    distributions.emplace_back("uniform 1-500", generate_sizes(std::uniform_int_distribution<>(1, 500), gen));
+    distributions.emplace_back("geometric mean 8", generate_sizes([](std::mt19937 & g) {
+        return std::geometric_distribution<>(1.0 / 8)(g) + 1;
+    }, gen));
+    distributions.emplace_back("bimodal 95% 1-16 / 5% 1024-8192", generate_sizes([](std::mt19937 & g) {
+        if (std::bernoulli_distribution(0.95)(g))
+            return std::uniform_int_distribution<>(1, 16)(g);
+        return std::uniform_int_distribution<>(1024, 8192)(g);
+    }, gen));
+    distributions.emplace_back("uniform 1-16384", generate_sizes(std::uniform_int_distribution<>(1, 16384), gen));
+
+    typedef void (*Variant)(bench::State &, int, const std::vector<int> &);
+    const std::vector<std::pair<std::string, Variant>> variants = {
+        { "Unconditional", unconditional_clear },
+        { "Conditional", conditional_clear },
+        { "Fresh std::vector", fresh_vector },
+        { "Uninitialized resize", uninitialized_resize },
+        { "pmr monotonic", pmr_monotonic },
+        { "pmr unsynchronized pool", pmr_pool },
+        { "Reuse pool", reuse_pool<std::vector<int>> },
+        { "Reuse pool uninitialized", reuse_pool<uninitialized_vector> },
+    };
+
+    for (const auto & distribution : distributions) {
+        for (const auto & variant : variants) {
+            harness.run(variant.first + " [" + distribution.first + "]", [&](bench::State & state) {
+                variant.second(state, resize_iterations, distribution.second);
+            }, resize_iterations, "resizes");
+        }
+    }
 }
@@ -0,0 +1,84 @@
+#include "tsc_clock.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <time.h>
+#include <vector>
+
+#include "asmlib.h"
+
+namespace bench {
+
+namespace {
+    const int CALIBRATION_ROUNDS = 5;
+    const uint64_t CALIBRATION_ROUND_NS = 10 * 1000 * 1000;
+    const int OVERHEAD_SAMPLES = 10000;
+
+    uint64_t monotonic_raw_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    bool cpuid_ext_edx_bit(unsigned int leaf, int bit) {
+        int abcd[4];
+        cpuid_ex(abcd, (int)0x80000000u, 0);
+        if ((unsigned int)abcd[0] < leaf)
+            return false;
+        cpuid_ex(abcd, (int)leaf, 0);
+        return (abcd[3] >> bit) & 1;
+    }
+
+    // Ratio of TSC ticks to CLOCK_MONOTONIC_RAW ns over several short spins; the median discards rounds
+    // that were preempted between the paired reads.
+    double calibrate() {
+        std::vector<double> rounds;
+        for (int round = 0; round < CALIBRATION_ROUNDS; ++round) {
+            const uint64_t ns_begin = monotonic_raw_ns();
+            const uint64_t ticks_begin = TscClock::start();
+            uint64_t ns_end;
+            do {
+                ns_end = monotonic_raw_ns();
+            } while (ns_end - ns_begin < CALIBRATION_ROUND_NS);
+            const uint64_t ticks_end = TscClock::stop();
+            rounds.push_back((double)(ticks_end - ticks_begin) / (ns_end - ns_begin));
+        }
+        std::sort(rounds.begin(), rounds.end());
+        return rounds[rounds.size() / 2];
+    }
+
+    uint64_t measure_overhead() {
+        uint64_t best = UINT64_MAX;
+        for (int k = 0; k < OVERHEAD_SAMPLES; ++k) {
+            const uint64_t begin = TscClock::start();
+            const uint64_t end = TscClock::stop();
+            best = std::min(best, end - begin);
+        }
+        return best;
+    }
+}
+
+bool TscClock::supported() {
+#ifdef BENCH_HAVE_TSC
+    // CPUID.80000007H:EDX[8], invariant TSC
+    static const bool invariant = cpuid_ext_edx_bit(0x80000007u, 8);
+    return invariant;
+#else
+    return false;
+#endif
+}
+
+// CPUID.80000001H:EDX[27]
+const bool TscClock::use_rdtscp_ = cpuid_ext_edx_bit(0x80000001u, 27);
+
+double TscClock::ticks_per_ns() {
+    static const double ratio = calibrate();
+    return ratio;
+}
+
+uint64_t TscClock::overhead() {
+    static const uint64_t ticks = measure_overhead();
+    return ticks;
+}
+
+} // namespace bench
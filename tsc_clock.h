@@ -0,0 +1,59 @@
+#ifndef TSC_CLOCK_H
+#define TSC_CLOCK_H
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+namespace bench {
+
+// Cycle-resolution timer on the time stamp counter, for regions short enough that a steady_clock read
+// (tens of ns, and a vDSO call) is a noticeable part of the measurement.
+//
+// start() fences so earlier instructions retire before the counter is read and later ones can't start
+// before it; stop() uses rdtscp, which waits for the timed code to finish, followed by a fence. Ticks
+// are converted to ns with a frequency calibrated against CLOCK_MONOTONIC_RAW, and overhead() is the
+// cost of an empty start/stop pair, for subtracting from each measured interval. Only meaningful when
+// supported(), i.e. on x86 with an invariant TSC that ticks at a constant rate across P-states.
+class TscClock {
+public:
+    static bool supported();
+
+    static uint64_t start() {
+#ifdef BENCH_HAVE_TSC
+        _mm_lfence();
+        const uint64_t ticks = __rdtsc();
+        _mm_lfence();
+        return ticks;
+#else
+        return 0;
+#endif
+    }
+
+    static uint64_t stop() {
+#ifdef BENCH_HAVE_TSC
+        unsigned int aux;
+        const uint64_t ticks = use_rdtscp_ ? __rdtscp(&aux) : (_mm_lfence(), __rdtsc());
+        _mm_lfence();
+        return ticks;
+#else
+        return 0;
+#endif
+    }
+
+    // Calibrated on first use (takes about 50 ms).
+    static double ticks_per_ns();
+    static uint64_t overhead();
+
+private:
+    // Resolved once at program start, so stop() reads a plain global instead of going through a
+    // function-local static guard inside the timed region.
+    static const bool use_rdtscp_;
+};
+
+} // namespace bench
+
+#endif // TSC_CLOCK_H
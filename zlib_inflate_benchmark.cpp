@@ -3,21 +3,83 @@
 #include <exception>
 #include <vector>
 #include <thread>
+#include <memory>
 #include <mutex>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <cmath>
+#include <random>
+#include <sstream>
 
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 
 #include "boost/iostreams/device/mapped_file.hpp"
 
 
 #include "zlib.h"
 
+#include "bench_harness.h"
+#include "block_cache.h"
+#include "mmap_readahead.h"
+
 namespace {
     const unsigned int MAX_BLOCK_SIZE = 65536;
+    const size_t MB = 1048576;
+    // read_mmap_into_buffer copies in chunks of this size, with the next chunk already requested.
+    const size_t MMAP_COPY_CHUNK = 8 * MB;
+}
+
+void init_raw_inflate(z_stream & zs) {
+    std::memset(&zs, 0, sizeof(zs));
+    int status = inflateInit2(&zs, -15);
+    if (status != Z_OK) {
+        throw std::runtime_error("Zlib initialization failed!");
+    }
+}
+
+// Inflates the BGZF block of the given compressed length at block_begin_index into out, which is
+// resized to the uncompressed size. zs must be set up for raw deflate and is reset for the next block.
+void inflate_block(z_stream & zs, const char * buffer, uint64_t block_begin_index, uint32_t length, std::vector<char> & out) {
+    if (buffer[block_begin_index] != (char)31 || buffer[block_begin_index+1] != (char)139) {
+        throw std::runtime_error("BgzfBlock header magic bytes don't match! Corrupt file?");
+    }
+
+    uint32_t uncompressed_size = 0;
+    std::memcpy(&uncompressed_size, buffer+block_begin_index+length-4, sizeof(uncompressed_size));
+
+    zs.next_in = (Bytef *)buffer+block_begin_index+18;
+    zs.avail_in = length - 16;
+
+    out.resize(MAX_BLOCK_SIZE);
+
+    zs.next_out = (Bytef *)out.data();
+    zs.avail_out = out.size();
+
+    auto inflate_status = inflate(&zs, Z_FINISH);
+    if (inflate_status != Z_STREAM_END) {
+        inflateEnd(&zs);
+        throw std::runtime_error("Zlib failed to decompress entire block!");
+    }
+
+    if (zs.total_out != uncompressed_size) {
+        std::cerr << "total_out: " << zs.total_out << " uncompressed_size: " << uncompressed_size << std::endl;
+        throw std::runtime_error("Uncompressed block size does not match expected!");
+    }
+    out.resize(uncompressed_size);
+
+    auto reset_status = inflateReset(&zs);
+    if (reset_status != Z_OK) {
+        throw std::runtime_error("Failed to reset zlib!");
+    }
 }
 
 class BamReader {
@@ -40,15 +102,13 @@ public:
 
     ~BamReader() {
         if (mode_ == "use_ifstream" || mode_ == "use_fread" || mode_ == "use_mmap_into_buffer") {
-            delete(buffer_);
+            delete[] buffer_;
         } else if (mode_ == "use_mmap") {
             munmap(buffer_, file_size_);
         }
     }
 
     void read_file_boost_mmap(const std::string & filename) {
-        std::cout << "Using boost::mapped_file_source" << std::endl;
-
         try {
             file.open(filename);
         } catch (std::ios::failure & e) {
@@ -65,14 +125,12 @@ public:
 
     void read_file_mmap(const std::string & filename_str) {
         const char * filename = filename_str.c_str();
-        std::cout << "Using POSIX mmap" << std::endl;
 
         int fd = open(filename, O_RDONLY);
         struct stat sb;
         fstat(fd, &sb);
 
         file_size_ = sb.st_size;
-        std::cout << "File size: " << file_size_ << std::endl;
 
         buffer_ = (char *)mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
         close(fd);
@@ -87,14 +145,12 @@ public:
 
     void read_mmap_into_buffer(const std::string & filename_str) {
         const char * filename = filename_str.c_str();
-        std::cout << "Using POSIX mmap into buffer" << std::endl;
 
         int fd = open(filename, O_RDONLY);
         struct stat sb;
         fstat(fd, &sb);
 
         file_size_ = sb.st_size;
-        std::cout << "File size: " << file_size_ << std::endl;
 
         char * mmap_buffer = (char *)mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
         close(fd);
@@ -108,38 +164,33 @@ public:
 
         buffer_ = new char[file_size_];
 
-        auto start = std::chrono::steady_clock::now();
-        std::memcpy(buffer_, mmap_buffer, file_size_);
+        // One big memcpy stalls on every page fault in turn; asking for the next chunk while copying
+        // the current one keeps the disk busy during the copy.
+        for (uint64_t begin = 0; begin < file_size_; begin += MMAP_COPY_CHUNK) {
+            const uint64_t length = std::min<uint64_t>(MMAP_COPY_CHUNK, file_size_ - begin);
+            if (begin + length < file_size_) {
+                madvise(mmap_buffer + begin + length, std::min<uint64_t>(MMAP_COPY_CHUNK, file_size_ - begin - length), MADV_WILLNEED);
+            }
+            std::memcpy(buffer_ + begin, mmap_buffer + begin, length);
+        }
         munmap(mmap_buffer, file_size_);
-        auto stop = std::chrono::steady_clock::now();
-        double file_size_compressed_MB = file_size_ / (1024 * 1024.0);
-        double time = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / 1000000000.0;
-        std::cout << "mmap read file into buffer at " << file_size_compressed_MB / time << " compressed MB/s" << std::endl;
     }
 
     void read_file_ifstream(const std::string & filename) {
-        std::cout << "Using ifstream" << std::endl;
         std::ifstream read_stream(filename, std::ios::in | std::ios::binary | std::ios::ate);
 
         file_size_ = read_stream.tellg();
-        std::cout << "File size: " << file_size_ << std::endl;
         read_stream.seekg(0, std::ios::beg);
 
         buffer_ = new char[file_size_];
 
-        auto start = std::chrono::steady_clock::now();
         if (!read_stream.read(buffer_, file_size_)) {
             throw std::runtime_error("Error reading file into buffer!");
         }
         read_stream.close();
-        auto stop = std::chrono::steady_clock::now();
-        double file_size_compressed_MB = file_size_ / (1024 * 1024.0);
-        double time = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / 1000000000.0;
-        std::cout << "ifstream read file at " << file_size_compressed_MB / time << " compressed MB/s" << std::endl;
     }
 
     void read_file_fread(const std::string & filename_str) {
-        std::cout << "Using fread" << std::endl;
         const char * filename = filename_str.c_str();
         FILE * infile = fopen(filename, "rb");
         if (infile == nullptr) {
@@ -148,19 +199,13 @@ public:
 
         fseek(infile, 0L, SEEK_END);
         file_size_ = ftell(infile);
-        std::cout << "File size: " << file_size_ << std::endl;
 
         fseek(infile, 0L, SEEK_SET);
 
         buffer_ = new char[file_size_];
 
-        auto start = std::chrono::steady_clock::now();
         fread(buffer_, sizeof(char), file_size_, infile);
         fclose(infile);
-        auto stop = std::chrono::steady_clock::now();
-        double file_size_compressed_MB = file_size_ / (1024 * 1024.0);
-        double time = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / 1000000000.0;
-        std::cout << "fread read file at " << file_size_compressed_MB / time << " compressed MB/s" << std::endl;
     }
 
     std::pair<uint64_t, uint32_t> getNextBlock() {
@@ -168,23 +213,75 @@ public:
         if (block_begin_index_ == file_size_)
             return { file_size_, 0 };
 
-        uint16_t length = 0;
-        std::memcpy(&length, buffer_+block_begin_index_+16, sizeof(length));
-        length+=1;
+        const uint32_t length = blockLength(block_begin_index_);
         auto ret = std::pair<uint64_t, uint32_t>(block_begin_index_, length);
         block_begin_index_ += length;
         return ret;
     }
 
+    // Offsets and compressed lengths of every block, for random access.
+    std::vector<std::pair<uint64_t, uint32_t>> getBlockIndex() const {
+        std::vector<std::pair<uint64_t, uint32_t>> index;
+        for (uint64_t begin = 0; begin < file_size_;) {
+            const uint32_t length = blockLength(begin);
+            index.emplace_back(begin, length);
+            begin += length;
+        }
+        return index;
+    }
+
+    // Decompressed contents of one block, from the cache when it has it. Misses are inflated and
+    // inserted; without a cache every call inflates.
+    BlockCache::Block readBlock(z_stream & zs, uint64_t block_begin_index, uint32_t length, BlockCache * cache) {
+        if (cache) {
+            if (BlockCache::Block block = cache->get(block_begin_index))
+                return block;
+        }
+        auto block = std::make_shared<std::vector<char>>();
+        inflate_block(zs, buffer_, block_begin_index, length, *block);
+        if (cache)
+            cache->put(block_begin_index, block);
+        return block;
+    }
+
+    // Hands out blocks from the start of the file again.
+    void rewind() {
+        std::lock_guard<std::mutex> lock(next_block_mutex_);
+        block_begin_index_ = 0;
+    }
+
     char * getBuffer() {
         return buffer_;
     }
 
+    bool isMapped() const {
+        return mode_ == "use_mmap" || mode_ == "use_boost_mmap";
+    }
+
     uint64_t getFileSize() {
         return file_size_;
     }
 
 private:
+    // Compressed length of the block starting at begin, checked to lie inside the file, so a truncated
+    // or non-BGZF file fails here instead of reading past the end of the buffer.
+    uint32_t blockLength(uint64_t begin) const {
+        if (begin + 18 > file_size_) {
+            throw std::runtime_error("Truncated BGZF block header at offset " + std::to_string(begin) + "!");
+        }
+        if (buffer_[begin] != (char)31 || buffer_[begin+1] != (char)139) {
+            throw std::runtime_error("BgzfBlock header magic bytes don't match at offset " + std::to_string(begin) + "! Not a BGZF file?");
+        }
+
+        uint16_t length = 0;
+        std::memcpy(&length, buffer_+begin+16, sizeof(length));
+        // 18 byte header plus the CRC32 and size footer.
+        if (length + 1 < 26 || begin + length + 1 > file_size_) {
+            throw std::runtime_error("Truncated BGZF block at offset " + std::to_string(begin) + "!");
+        }
+        return length + 1;
+    }
+
     char * buffer_;
 
     boost::iostreams::mapped_file_source file;
@@ -198,85 +295,458 @@ private:
 
 };
 
-int main(int argc, char * argv[]) {
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " /path/to/bam/file num_threads [use_ifstream]" << std::endl;
-        return -1;
+// Drops the file from the page cache and the mapping's pages from this process, so the next pass over
+// the mapping reads from disk again.
+void evict_file_pages(const std::string & filename, char * buffer, uint64_t size) {
+    madvise(buffer, size, MADV_DONTNEED);
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + filename + "!");
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+struct FaultCounts {
+    long major;
+    long minor;
+};
+
+FaultCounts fault_counts() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return { usage.ru_majflt, usage.ru_minflt };
+}
+
+// Runs body(k) for every k below num_threads, each on its own thread. An exception escaping a
+// std::thread terminates the process, so the first one thrown is kept and rethrown here once every
+// thread has joined.
+template <typename Body>
+void run_threads(int num_threads, Body body) {
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    std::vector<std::thread> thread_vec;
+    thread_vec.reserve(num_threads);
+    for (int k = 0; k < num_threads; ++k) {
+        thread_vec.emplace_back([&, k]() {
+            try {
+                body(k);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        });
+    }
+    for (auto & thread : thread_vec) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Block indices of a skewed random-access pattern: block popularity follows a Zipf distribution with
+// the given exponent, with popularity ranks assigned to blocks in random order so the hot blocks are
+// spread over the file instead of clustered at its start.
+std::vector<uint32_t> zipf_trace(size_t num_blocks, size_t num_accesses, double exponent) {
+    std::mt19937 gen(42);
+
+    std::vector<double> cdf(num_blocks);
+    double total = 0;
+    for (size_t rank = 0; rank < num_blocks; ++rank) {
+        total += 1.0 / std::pow((double)(rank + 1), exponent);
+        cdf[rank] = total;
+    }
+
+    std::vector<uint32_t> block_of_rank(num_blocks);
+    for (size_t k = 0; k < num_blocks; ++k) {
+        block_of_rank[k] = (uint32_t)k;
     }
+    std::shuffle(block_of_rank.begin(), block_of_rank.end(), gen);
 
-    BamReader reader(argv[1], argc == 3 ? "" : argv[3]);
-    const int NUM_THREADS = std::stoi(argv[2]);
+    std::uniform_real_distribution<> uniform(0, total);
+    std::vector<uint32_t> trace(num_accesses);
+    for (auto & block : trace) {
+        const size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) - cdf.begin();
+        block = block_of_rank[std::min(rank, num_blocks - 1)];
+    }
+    return trace;
+}
 
-    auto deflateProc = [&reader]() {
+// Threads split the trace round-robin and read every block through the cache (or straight from the
+// inflate path when cache is null), recording the latency of each access. The cache starts empty on
+// every run, so the hit rate is that of one replay of the trace within the memory budget.
+void zipf_replay(bench::State & state, BamReader & reader, const std::vector<std::pair<uint64_t, uint32_t>> & index,
+                 const std::vector<uint32_t> & trace, int num_threads, BlockCache * cache) {
+    state.pause_timing();
+    if (cache)
+        cache->clear();
+    std::vector<std::vector<int64_t>> latencies(num_threads);
+    state.resume_timing();
+
+    run_threads(num_threads, [&](int t) {
         z_stream zs;
-        zs.zalloc = nullptr;
-        zs.zfree = nullptr;
-        int status = inflateInit2(&zs, -15);
-        if (status != Z_OK) {
-            throw std::runtime_error("Zlib initialization failed!");
+        init_raw_inflate(zs);
+        std::vector<int64_t> & local = latencies[t];
+        local.reserve(trace.size() / num_threads + 1);
+
+        for (size_t k = t; k < trace.size(); k += num_threads) {
+            const auto begin = std::chrono::steady_clock::now();
+            BlockCache::Block block = reader.readBlock(zs, index[trace[k]].first, index[trace[k]].second, cache);
+            bench::do_not_optimize(block->data());
+            local.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
         }
+        inflateEnd(&zs);
+    });
+    state.pause_timing();
 
-        while(true) {
-            auto block = reader.getNextBlock();
+    std::vector<int64_t> all;
+    for (auto & local : latencies) {
+        all.insert(all.end(), local.begin(), local.end());
+    }
+    std::sort(all.begin(), all.end());
 
-            if (block.second == 0)
-                return;
+    auto percentile = [&all](double p) {
+        return (double)all[std::min(all.size() - 1, (size_t)(p * all.size()))];
+    };
 
-            const uint64_t block_begin_index = block.first;
-            const uint32_t length = block.second;
-            const char * buffer = reader.getBuffer();
+    state.add_counter("p50_ns", percentile(0.50));
+    state.add_counter("p99_ns", percentile(0.99));
+    state.add_counter("max_ns", (double)all.back());
+    if (cache)
+        state.add_counter("hit_rate", (double)cache->hits() / (cache->hits() + cache->misses()));
+}
 
-            if (buffer[block_begin_index] != (char)31 || buffer[block_begin_index+1] != (char)139) {
-                throw std::runtime_error("BgzfBlock header magic bytes don't match! Corrupt file?");
-            }
+// Inflates blocks of reader until there are none left, into one output buffer reused across blocks.
+// Workers report the block they are on to the readahead stage, if there is one.
+void deflateProc(BamReader & reader, int worker, MmapReadahead * readahead) {
+    z_stream zs;
+    init_raw_inflate(zs);
+    std::vector<char> uncompressed_data(MAX_BLOCK_SIZE);
+
+    while(true) {
+        auto block = reader.getNextBlock();
+        if (readahead)
+            readahead->update(worker, block.first);
+
+        if (block.second == 0) {
+            inflateEnd(&zs);
+            return;
+        }
 
-            uint32_t uncompressed_size = 0;
-            std::memcpy(&uncompressed_size, buffer+block_begin_index+length-4, sizeof(uncompressed_size));
+        inflate_block(zs, reader.getBuffer(), block.first, block.second, uncompressed_data);
+    }
+}
+
+// Hands out blocks from many files to one shared worker pool. Each file's blocks go out in file order.
+// The files in progress get one block each in turn, so a big file can't hold up the others, and at most
+// max_active files are in progress at once, so each file finishes soon after it starts instead of all
+// of them finishing together at the very end.
+class BatchScheduler {
+public:
+    struct Task {
+        size_t file;
+        uint64_t block_begin_index;
+        uint32_t length;
+    };
 
+    BatchScheduler(const std::vector<std::vector<std::pair<uint64_t, uint32_t>>> & indexes, size_t max_active)
+        : indexes_(indexes), max_active_(std::max<size_t>(max_active, 1)), next_file_(0),
+          next_block_(indexes.size(), 0), remaining_(indexes.size()) {
+        for (size_t f = 0; f < indexes.size(); ++f) {
+            remaining_[f] = indexes[f].size();
+        }
+    }
 
-            zs.next_in = (Bytef *)buffer+block_begin_index+18;
-            zs.avail_in = length - 16;
+    // False once every block of every file has been handed out.
+    bool next(Task & task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (active_.size() < max_active_ && next_file_ < indexes_.size()) {
+            if (!indexes_[next_file_].empty())
+                active_.push_back(next_file_);
+            ++next_file_;
+        }
+        if (active_.empty())
+            return false;
 
-            std::vector<char> uncompressed_data(MAX_BLOCK_SIZE);
+        const size_t file = active_.front();
+        active_.pop_front();
+        const auto & block = indexes_[file][next_block_[file]++];
+        if (next_block_[file] < indexes_[file].size())
+            active_.push_back(file);
+
+        task = { file, block.first, block.second };
+        return true;
+    }
+
+    // Marks one block of file as inflated; true if it was the file's last one.
+    bool complete(size_t file) {
+        return remaining_[file].fetch_sub(1) == 1;
+    }
 
-            zs.next_out = (Bytef *)uncompressed_data.data();
-            zs.avail_out = uncompressed_data.size();
+private:
+    const std::vector<std::vector<std::pair<uint64_t, uint32_t>>> & indexes_;
+    const size_t max_active_;
+
+    std::mutex mutex_;
+    std::deque<size_t> active_;
+    size_t next_file_;
+    std::vector<size_t> next_block_;
+    std::vector<std::atomic<size_t>> remaining_;
+};
+
+void add_completion_counters(bench::State & state, std::vector<double> completion_ms) {
+    std::sort(completion_ms.begin(), completion_ms.end());
+    double sum = 0;
+    for (double ms : completion_ms) {
+        sum += ms;
+    }
+    state.add_counter("file_mean_ms", sum / completion_ms.size());
+    state.add_counter("file_p50_ms", completion_ms[completion_ms.size() / 2]);
+    state.add_counter("file_max_ms", completion_ms.back());
+}
+
+// True if the file starts with a BGZF block header: gzip magic, deflate, FEXTRA set and a "BC" extra
+// subfield. Index files are skipped by extension, since .csi and .tbi are BGZF compressed themselves.
+bool is_bgzf(const std::filesystem::path & path) {
+    const std::string extension = path.extension().string();
+    if (extension == ".bai" || extension == ".csi" || extension == ".tbi" || extension == ".gzi")
+        return false;
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    unsigned char header[14];
+    if (!in.read((char *)header, sizeof(header)))
+        return false;
+    return header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4) && header[12] == 'B' && header[13] == 'C';
+}
 
-            auto inflate_status = inflate(&zs, Z_FINISH);
-            if (inflate_status != Z_STREAM_END) {
-                inflateEnd(&zs);
-                throw std::runtime_error("Zlib failed to decompress entire block!");
+// Every path is a file, or a directory whose BGZF files are all taken, in name order.
+std::vector<std::string> expand_paths(const std::vector<std::string> & paths) {
+    std::vector<std::string> files;
+    for (const auto & path : paths) {
+        if (std::filesystem::is_directory(path)) {
+            std::vector<std::string> entries;
+            for (const auto & entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file() && is_bgzf(entry.path()))
+                    entries.push_back(entry.path().string());
             }
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        } else if (std::filesystem::exists(path)) {
+            files.push_back(path);
+        } else {
+            throw std::runtime_error("No such file: " + path);
+        }
+    }
+    return files;
+}
+
+// Batch mode: many files through one shared worker pool, against the same files inflated one after
+// another with a fresh thread set each. Files are memory mapped (use_mmap).
+int run_batch(bench::Harness & harness, int num_threads, const std::vector<std::string> & paths) {
+    const std::vector<std::string> files = expand_paths(paths);
+    if (files.empty()) {
+        throw std::runtime_error("No input files!");
+    }
+
+    // Opening and indexing are spread over the pool too, one file at a time per thread.
+    std::vector<std::unique_ptr<BamReader>> readers(files.size());
+    std::vector<std::vector<std::pair<uint64_t, uint32_t>>> indexes(files.size());
+    harness.run("batch index " + std::to_string(files.size()) + " files", [&](bench::State & state) {
+        state.pause_timing();
+        for (auto & reader : readers) {
+            reader.reset();
+        }
+        state.resume_timing();
 
-            if (zs.total_out != uncompressed_size) {
-                std::cerr << "total_out: " << zs.total_out << " uncompressed_size: " << uncompressed_size << std::endl;
-                throw std::runtime_error("Uncompressed block size does not match expected!");
+        std::atomic<size_t> next_file(0);
+        run_threads(num_threads, [&](int) {
+            for (size_t f = next_file++; f < files.size(); f = next_file++) {
+                readers[f].reset(new BamReader(files[f], "use_mmap"));
+                indexes[f] = readers[f]->getBlockIndex();
             }
+        });
+    }, (double)files.size(), "files");
+
+    double total_bytes = 0;
+    for (const auto & reader : readers) {
+        total_bytes += reader->getFileSize();
+    }
+
+    // Completion time of every file since the start of the run, from the last run of each kind.
+    std::vector<double> shared_completion_ms(files.size());
+    std::vector<double> sequential_completion_ms(files.size());
+
+    harness.run("batch shared pool " + std::to_string(num_threads) + " threads", [&](bench::State & state) {
+        BatchScheduler scheduler(indexes, num_threads);
+        const auto start = std::chrono::steady_clock::now();
+
+        run_threads(num_threads, [&](int) {
+            z_stream zs;
+            init_raw_inflate(zs);
+            std::vector<char> uncompressed_data(MAX_BLOCK_SIZE);
 
-            auto reset_status = inflateReset(&zs);
-            if (reset_status != Z_OK) {
-                throw std::runtime_error("Failed to reset zlib!");
+            BatchScheduler::Task task;
+            while (scheduler.next(task)) {
+                inflate_block(zs, readers[task.file]->getBuffer(), task.block_begin_index, task.length, uncompressed_data);
+                if (scheduler.complete(task.file)) {
+                    shared_completion_ms[task.file] =
+                        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                }
             }
+            inflateEnd(&zs);
+        });
+
+        state.pause_timing();
+        add_completion_counters(state, shared_completion_ms);
+    }, total_bytes, "bytes");
+
+    harness.run("batch sequential " + std::to_string(num_threads) + " threads", [&](bench::State & state) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t f = 0; f < files.size(); ++f) {
+            readers[f]->rewind();
+            run_threads(num_threads, [&](int k) {
+                deflateProc(*readers[f], k, nullptr);
+            });
+            sequential_completion_ms[f] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         }
 
-    };
+        state.pause_timing();
+        add_completion_counters(state, sequential_completion_ms);
+    }, total_bytes, "bytes");
 
-    std::vector<std::thread> thread_vec;
-    thread_vec.reserve(NUM_THREADS);
+    harness.log() << "Per-file completion, ms since start (last run): shared pool / sequential" << std::endl;
+    for (size_t f = 0; f < files.size(); ++f) {
+        harness.log() << "  " << files[f] << " " << readers[f]->getFileSize() << " bytes: "
+                      << shared_completion_ms[f] << " / " << sequential_completion_ms[f] << std::endl;
+    }
+    return 0;
+}
 
-    auto start = std::chrono::steady_clock::now();
-    for (int k = 0; k < NUM_THREADS; ++k) {
-        thread_vec.emplace_back(deflateProc);
+// Single file mode: loading, inflate with the file's own threads, readahead and Zipf replay.
+int run_file(bench::Harness & harness) {
+    if (harness.args().size() < 2 || harness.args().size() > 7) {
+        return harness.usage_error();
     }
 
-    for (auto & thread : thread_vec) {
-        thread.join();
+    const std::string filename = harness.args()[0];
+    const int NUM_THREADS = std::stoi(harness.args()[1]);
+    const std::string mode = harness.args().size() > 2 ? harness.args()[2] : "use_ifstream";
+    const size_t readahead_mb = harness.args().size() > 3 ? std::stoull(harness.args()[3]) : 0;
+    const size_t num_accesses = harness.args().size() > 4 ? std::stoull(harness.args()[4]) : 0;
+    const double zipf_exponent = harness.args().size() > 5 ? std::stod(harness.args()[5]) : 1.0;
+    const size_t cache_mb = harness.args().size() > 6 ? std::stoull(harness.args()[6]) : 64;
+    if (harness.args().size() > 4 && num_accesses == 0) {
+        return harness.usage_error();
+    }
+
+    // Loading is timed on its own; for the mmap modes it only maps the file and the page faults land in
+    // the inflate phase instead.
+    std::unique_ptr<BamReader> reader_ptr;
+    harness.run("load " + mode, [&](bench::State & state) {
+        state.pause_timing();
+        reader_ptr.reset();
+        state.resume_timing();
+
+        reader_ptr.reset(new BamReader(filename, mode));
+        state.set_items_processed(reader_ptr->getFileSize());
+    }, 0, "bytes");
+
+    BamReader & reader = *reader_ptr;
+    harness.log() << "File size: " << reader.getFileSize() << std::endl;
+
+    // cold: start every run with the file out of the page cache. readahead_bytes: run the readahead
+    // stage with that window alongside the workers (mapped modes only).
+    auto inflate_run = [&](const std::string & name, bool cold, uint64_t readahead_bytes) {
+        harness.run(name, [&](bench::State & state) {
+            state.pause_timing();
+            reader.rewind();
+            if (cold)
+                evict_file_pages(filename, reader.getBuffer(), reader.getFileSize());
+            const FaultCounts before = fault_counts();
+            state.resume_timing();
+
+            std::unique_ptr<MmapReadahead> readahead;
+            if (readahead_bytes > 0)
+                readahead.reset(new MmapReadahead(filename, reader.getBuffer(), reader.getFileSize(), readahead_bytes, NUM_THREADS));
+
+            run_threads(NUM_THREADS, [&](int k) {
+                deflateProc(reader, k, readahead.get());
+            });
+            const uint64_t willneed_bytes = readahead ? readahead->willneed_bytes() : 0;
+            const uint64_t dontneed_bytes = readahead ? readahead->dontneed_bytes() : 0;
+            readahead.reset();
+
+            state.pause_timing();
+            const FaultCounts after = fault_counts();
+            state.add_counter("major_faults", (double)(after.major - before.major));
+            state.add_counter("minor_faults", (double)(after.minor - before.minor));
+            if (readahead_bytes > 0) {
+                state.add_counter("willneed_bytes", (double)willneed_bytes);
+                state.add_counter("dontneed_bytes", (double)dontneed_bytes);
+            }
+        }, reader.getFileSize(), "bytes");
+    };
+
+    inflate_run("inflate " + std::to_string(NUM_THREADS) + " threads", false, 0);
+
+    // Plain mmap against the readahead stage, both from a cold page cache, so the faults in the
+    // plain run are real disk reads in the middle of decompression.
+    if (readahead_mb > 0) {
+        if (reader.isMapped()) {
+            inflate_run("inflate " + std::to_string(NUM_THREADS) + " threads cold " + mode, true, 0);
+            inflate_run("inflate " + std::to_string(NUM_THREADS) + " threads cold " + mode + " + readahead " + std::to_string(readahead_mb) + "MB",
+                        true, readahead_mb * MB);
+        } else {
+            harness.log() << "Readahead only applies to use_mmap and use_boost_mmap, skipping" << std::endl;
+        }
     }
-    auto stop = std::chrono::steady_clock::now();
 
-    double file_size_compressed_MB = reader.getFileSize() / (1024 * 1024.0);
-    double time = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / 1000000000.0;
+    if (num_accesses > 0) {
+        const auto index = reader.getBlockIndex();
+        if (index.empty()) {
+            throw std::runtime_error("No blocks to replay in " + filename + "!");
+        }
+        const auto trace = zipf_trace(index.size(), num_accesses, zipf_exponent);
+
+        // Throughput counts the decompressed bytes delivered to the readers.
+        double delivered_bytes = 0;
+        for (uint32_t block : trace) {
+            uint32_t uncompressed_size = 0;
+            std::memcpy(&uncompressed_size, reader.getBuffer() + index[block].first + index[block].second - 4, sizeof(uncompressed_size));
+            delivered_bytes += uncompressed_size;
+        }
+
+        std::ostringstream name;
+        name << "zipf s=" << zipf_exponent << " " << NUM_THREADS << " threads";
+        harness.log() << index.size() << " blocks, " << num_accesses << " accesses" << std::endl;
 
-    std::cout << "Deflating took: " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms" << std::endl;
-    std::cout << "Deflated file at " << file_size_compressed_MB / time << " compressed MB/s" << std::endl;
+        harness.run(name.str() + " no cache", [&](bench::State & state) {
+            zipf_replay(state, reader, index, trace, NUM_THREADS, nullptr);
+        }, delivered_bytes, "bytes");
+
+        BlockCache cache(cache_mb * MB);
+        harness.run(name.str() + " cache " + std::to_string(cache_mb) + "MB", [&](bench::State & state) {
+            zipf_replay(state, reader, index, trace, NUM_THREADS, &cache);
+        }, delivered_bytes, "bytes");
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    bench::Harness harness(argc, argv, "/path/to/bam/file num_threads [use_ifstream|use_fread|use_mmap|use_boost_mmap|use_mmap_into_buffer] "
+                                       "[readahead_MB] [zipf_accesses [zipf_exponent] [cache_MB]] | batch num_threads file_or_directory...");
+    try {
+        if (harness.args().size() >= 3 && harness.args()[0] == "batch") {
+            return run_batch(harness, std::stoi(harness.args()[1]),
+                             std::vector<std::string>(harness.args().begin() + 2, harness.args().end()));
+        }
+        return run_file(harness);
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
 }